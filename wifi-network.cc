@@ -17,28 +17,49 @@
  * Author: Sebastien Deronne <sebastien.deronne@gmail.com>
  */
 
+#include "ns3/ap-wifi-mac.h"
 #include "ns3/boolean.h"
 #include "ns3/command-line.h"
 #include "ns3/config.h"
 #include "ns3/double.h"
 #include "ns3/enum.h"
+#include "ns3/erp-ofdm-phy.h"
+#include "ns3/he-configuration.h"
+#include "ns3/he-frame-exchange-manager.h"
 #include "ns3/he-phy.h"
 #include "ns3/internet-stack-helper.h"
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/ipv4-static-routing-helper.h"
 #include "ns3/log.h"
 #include "ns3/mobility-helper.h"
+#include "ns3/mpdu-aggregator.h"
+#include "ns3/msdu-aggregator.h"
 #include "ns3/multi-model-spectrum-channel.h"
+#include "ns3/multi-user-scheduler.h"
+#include "ns3/ofdm-phy.h"
 #include "ns3/on-off-helper.h"
 #include "ns3/packet-sink-helper.h"
 #include "ns3/packet-sink.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/qos-txop.h"
+#include "ns3/qos-utils.h"
+#include "ns3/radiotap-header.h"
 #include "ns3/rng-seed-manager.h"
 #include "ns3/spectrum-wifi-helper.h"
 #include "ns3/ssid.h"
 #include "ns3/string.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/socket.h"
 #include "ns3/udp-client-server-helper.h"
+#include "ns3/udp-socket-factory.h"
 #include "ns3/uinteger.h"
 #include "ns3/wifi-acknowledgment.h"
+#include "ns3/wifi-mac-queue.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/wifi-tx-parameters.h"
+#include "ns3/wifi-tx-vector.h"
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/flow-monitor-module.h"
@@ -48,7 +69,28 @@
 #include "ns3/core-module.h"
 #include "ns3/internet-module.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
 #include <functional>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
 
 #include <iostream>
 #include <fstream>
@@ -69,16 +111,50 @@
 // Packets in this simulation belong to BestEffort Access Class (AC_BE).
 // By selecting an acknowledgment sequence for DL MU PPDUs, it is possible to aggregate a
 // Round Robin scheduler to the AP, so that DL MU PPDUs are sent by the AP via DL OFDMA.
+// With --muScheduler=pf or maxweight, the number of stations served per MU PPDU (hence the size
+// of their RUs) is chosen from the backlog and the rate of the stations instead of being fixed;
+// --compareMuSchedulers simulates the three schedulers side by side.
+//
+// A single run simulates the MCS, channel width and guard interval given on the command line.
+// The --grid option sweeps several MCS, channel width, guard interval and seed values instead: the
+// points are simulated in parallel by a pool of worker processes and merged in a single table.
+//
+// By default the traffic starts after 1 s, which leaves time for the stations to associate. With
+// --preAssociate the association and the block ack agreements are completed first, and the
+// traffic starts as soon as they are.
+//
+// The stations are placed around the AP according to --placement: on a circle of radius distance
+// (disc), on a square grid with a spacing of distance (grid) or uniformly at random in a disc of
+// radius distance (random). The nodes do not move, so the path loss between every pair of nodes is
+// computed once after they are placed and then looked up for each transmission.
+//
+// With --macSaturation the Internet stack and the applications are left out: once the stations
+// are associated, the BE queue of every sending device is kept filled with frames handed directly
+// to the WifiNetDevice, and the goodput is measured by the receiving WifiNetDevice.
+//
+// --analytic replaces the simulation by a Bianchi model of the DCF fed with the HE PPDU durations,
+// which gives the goodput in an instant. In sweep mode, --prescreen simulates only the points whose
+// offered load is close to the capacity estimated by the model (and the OFDMA points, which the
+// model does not cover), and compares the model with the simulation where both are available.
+//
+// --nBss deploys several BSSs, with their APs on a square grid of spacing --bssSpacing and
+// nStations stations around each AP, on the channels of --channelPlan. The BSSs whose channels do
+// not overlap cannot interfere, so the groups of BSSs sharing spectrum are simulated as separate
+// scenarios, in parallel, and their results are merged.
+//
+// --load is the offered load of the clients of a BSS, split evenly among its stations.
+// --capacitySearch searches the highest load at which the loss and the 99th percentile of the
+// delay stay below given thresholds, simulating several loads per round in parallel.
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("he-wifi-network");
 
-Ptr<StaWifiMac> GetFirstStaWifiMac(NodeContainer& sta);
-void PopulateARPcache ();
-
-int
-main(int argc, char* argv[])
+/**
+ * Parameters of a single simulated scenario. Every field can be set from the command line; in
+ * sweep mode the grid dimensions override the corresponding fields for each point.
+ */
+struct ScenarioConfig
 {
     bool udp{false};
     bool downlink{true};
@@ -86,72 +162,1636 @@ main(int argc, char* argv[])
     bool useExtendedBlockAck{false};
     double simulationTime{10}; // seconds
     double distance{1.0};      // meters
+    std::string placement{"list"}; // station placement (list, disc, grid or random)
+    bool cachePathLoss{true};      // whether to precompute the path loss between the static nodes
     double frequency{5};       // whether 2.4, 5 or 6 GHz
-    std::size_t nStations{1};
+    std::size_t nStations{1};  // stations of every BSS
+    uint32_t nBss{1};
+    double bssSpacing{20};      // meters between neighboring APs
+    std::string channelPlan;    // channel numbers given to the BSSs in turn (empty: default)
+    std::vector<uint32_t> bss;  // BSSs simulated by the run (empty: all), set by PartitionBss()
     std::string dlAckSeqType{"NO-OFDMA"};
     bool enableUlOfdma{false};
     bool enableBsrp{false};
-    uint32_t payloadSize {1472}; // must fit in the max TX duration when transmitting at MCS 0 over an RU of 26 tones
+    std::string muScheduler{"rr"}; // policy of the MU scheduler (rr, pf or maxweight)
+    uint32_t payloadSize{1472}; // must fit in the max TX duration when transmitting at MCS 0 over an RU of 26 tones
     std::string phyModel{"Yans"};
-    double minExpectedThroughput{0};
-    double maxExpectedThroughput{0};
     Time accessReqInterval{0};
-    int channelWidth  {40};
-    int mcs {11};
-    double load {300 * 1000 * 1000};
-    double   offeredLoad = load / nStations; // [Mbps]
-    double   timeInterval = (payloadSize * 8)/(offeredLoad);
-    bool   displayFlowStats {true};
-    bool showStats {true};
-    int RgnRun {0};
+    int channelWidth{40};
+    int mcs{11};
+    int guardInterval{800}; // nanoseconds
+    double load{300};       // Mbit/s offered by the clients of a BSS, split among its stations
+    uint32_t burstSize{1};  // UDP packets sent by a client at once
+    uint32_t seed{1};
+    int rngRun{0};
+    std::string scheduler{"Map"}; // event scheduler (Map, Heap, List or Calendar)
+    bool preAssociate{false};
+    bool globalRouting{false};
+    bool flowMonitor{false}; // whether to collect the flow statistics with FlowMonitor
+    bool macPhyStats{false}; // whether to count the MAC and PHY events of every station
+    bool macSaturation{false}; // whether to feed the MAC queues directly, without IP stack
+    uint32_t macBacklog{400};  // MPDUs kept in the BE queue of a sender in MAC saturation mode
+    Time sampleInterval{0}; // interval between two throughput samples (0 disables sampling)
+    std::string samplesFile{"throughput-samples.csv"};
+    std::string pcapPrefix;        // prefix of the pcap files (empty disables the capture)
+    std::string pcapDevices{"ap"}; // captured devices (ap, covert, stations, all or indices)
+    uint32_t pcapSnapLen{128};     // bytes captured per frame (0 captures the whole frames)
+    uint32_t pcapFileSize{0};      // MB per pcap file (0 does not limit the size)
+    Time pcapWindow{0};            // simulated time per pcap file (0 does not limit the time)
+    uint32_t pcapMaxFiles{0};      // pcap files kept per device (0 keeps them all)
+    double steadyStateTolerance{0}; // relative CI half-width that stops the run (0 disables)
+    Time batchDuration{MilliSeconds(100)};
+    uint32_t minBatches{10};
+    bool displayFlowStats{true};
+    bool showStats{true};
+};
+
+/**
+ * Stops the simulation once the aggregate goodput has reached a steady state.
+ *
+ * The traffic is split in batches of fixed duration, and the goodput of each batch is computed
+ * from the server counters. The first batch, which includes the ramp-up, is discarded. Once at
+ * least minBatches batches are available, the simulation is stopped as soon as the half-width of
+ * the 95% confidence interval of the batch means falls below the given fraction of their mean.
+ */
+class SteadyStateDetector
+{
+  public:
+    /**
+     * \param servers the server application of each station
+     * \param udp whether the servers are UdpServer (PacketSink otherwise) applications
+     * \param payloadSize the size of the UDP payloads
+     * \param batchDuration the duration of a batch
+     * \param minBatches the minimum number of batches before stopping
+     * \param tolerance the relative half-width of the confidence interval that stops the run
+     */
+    SteadyStateDetector(const ApplicationContainer& servers,
+                        bool udp,
+                        uint32_t payloadSize,
+                        Time batchDuration,
+                        uint32_t minBatches,
+                        double tolerance);
+
+    /**
+     * Start monitoring the goodput.
+     *
+     * \param delay the time, relative to now, at which the traffic starts
+     */
+    void Start(Time delay);
+
+  private:
+    /// Close the current batch and check whether the steady state is reached
+    void EndBatch();
+
+    ApplicationContainer m_servers;
+    bool m_udp;
+    uint32_t m_payloadSize;
+    Time m_batchDuration;
+    uint32_t m_minBatches;
+    double m_tolerance;
+    uint64_t m_lastRxBytes{0};
+    uint32_t m_nBatches{0}; //!< number of batches ended, including the discarded one
+    double m_sum{0};        //!< sum of the batch means
+    double m_sumSquares{0}; //!< sum of the squared batch means
+};
+
+/**
+ * Periodically samples the number of bytes received by the server application of every station.
+ *
+ * The samples are stored in a ring buffer allocated once, so that taking a sample only reads the
+ * counters. The buffer is written to the output file whenever it is full and at the end of the
+ * run. The file has one line per sample: the time elapsed since the start of the traffic, followed
+ * by the cumulative number of bytes received by each station.
+ */
+class ThroughputSampler
+{
+  public:
+    /**
+     * \param servers the server application of each station
+     * \param udp whether the servers are UdpServer (PacketSink otherwise) applications
+     * \param payloadSize the size of the UDP payloads
+     * \param interval the interval between two samples
+     * \param path the output file
+     * \param capacity the number of samples held in the ring buffer
+     */
+    ThroughputSampler(const ApplicationContainer& servers,
+                      bool udp,
+                      uint32_t payloadSize,
+                      Time interval,
+                      const std::string& path,
+                      std::size_t capacity = 4096);
+
+    /**
+     * Start sampling.
+     *
+     * \param delay the time, relative to now, of the first sample
+     */
+    void Start(Time delay);
+    /// Write the buffered samples to the output file
+    void Flush();
+
+  private:
+    /// Take a sample and schedule the next one
+    void Sample();
+
+    std::vector<Ptr<UdpServer>> m_udpServers;
+    std::vector<Ptr<PacketSink>> m_packetSinks;
+    std::size_t m_nStations;
+    uint32_t m_payloadSize;
+    Time m_interval;
+    Time m_start;
+    std::size_t m_capacity;
+    std::vector<double> m_times;   //!< sample times, m_capacity entries
+    std::vector<uint64_t> m_bytes; //!< received bytes, m_capacity x m_nStations entries
+    std::size_t m_head{0};         //!< position of the next sample
+    std::size_t m_size{0};         //!< number of samples not written yet
+    std::ofstream m_file;
+};
+
+/**
+ * Propagation loss model serving the loss between static nodes from a precomputed matrix.
+ *
+ * Once the nodes are placed, Build() evaluates the wrapped model once for every pair of nodes and
+ * stores the resulting gains in a contiguous array indexed by node ID, so that each transmission
+ * only costs a lookup. The nodes must not move after Build() has been called. Pairs involving a
+ * node unknown to the cache are forwarded to the wrapped model.
+ */
+class StaticPropagationLossCache : public PropagationLossModel
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * \param model the propagation loss model computing the cached values
+     */
+    void SetModel(Ptr<PropagationLossModel> model);
+
+    /**
+     * Compute the loss between every pair of the given nodes.
+     *
+     * \param nodes the nodes, with their mobility model installed
+     */
+    void Build(const NodeContainer& nodes);
+
+  private:
+    double DoCalcRxPower(double txPowerDbm,
+                         Ptr<MobilityModel> a,
+                         Ptr<MobilityModel> b) const override;
+    int64_t DoAssignStreams(int64_t stream) override;
+
+    Ptr<PropagationLossModel> m_model;
+    std::size_t m_nNodes{0};    //!< number of rows of the matrix
+    std::vector<double> m_gain; //!< rx power - tx power in dB, m_nNodes x m_nNodes entries
+};
+
+/**
+ * UDP client sending packets of constant size at a constant rate, in bursts.
+ *
+ * Every burstSize intervals, a single event sends the burstSize packets due in these intervals,
+ * so that the number of packets sent before the application stops and the mean offered load are
+ * the same as with UdpClient, for a fraction of the events. The packets of a burst are stamped
+ * with the time of the burst and sent back to back, though: with burstSize > 1 the arrival
+ * process is burstier than with UdpClient, and so are the queue lengths and the measured delays.
+ * Like with UdpClient, each packet starts
+ * with a SeqTs header, so that UdpServer can be used as the receiver. The payloads are copies of
+ * a single zero-filled packet, which share its buffer: only the header is written per packet.
+ */
+class PooledUdpClient : public Application
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+  private:
+    void StartApplication() override;
+    void StopApplication() override;
+
+    /// Send the packets of a burst and schedule the next burst
+    void SendBurst();
+
+    Address m_peer;
+    uint32_t m_size;
+    Time m_interval;
+    uint32_t m_burstSize;
+    Ptr<Socket> m_socket;
+    Ptr<Packet> m_payload; //!< zero-filled payload shared by all the packets
+    uint32_t m_sent{0};
+    Time m_nextTx;  //!< time at which the next packet is due
+    Time m_stopTx;  //!< time at which the application stops, infinite if never
+    EventId m_sendEvent;
+    TracedCallback<Ptr<const Packet>> m_txTrace;
+};
+
+/**
+ * Histogram of packet delays with logarithmic buckets, in the manner of an HDR histogram.
+ *
+ * Delays are counted in nanoseconds. The values below 64 ns have a bucket each; above, every
+ * power of two is split in 32 buckets, so that a bucket is at most 1/32 of its values wide and
+ * its midpoint, which stands for its values, is within 1/64 (1.6%) of each of them. The buckets are allocated with the first value, after which
+ * the histogram uses a fixed amount of memory whatever the number of values. Histograms are
+ * merged by adding their buckets, e.g. to pool the stations or the replications of a scenario.
+ */
+class DelayHistogram
+{
+  public:
+    /**
+     * Count a delay.
+     *
+     * \param delay the delay
+     */
+    void Add(Time delay);
+    /**
+     * Add the values counted by another histogram.
+     *
+     * \param other the other histogram
+     */
+    void Merge(const DelayHistogram& other);
+    /// \return the number of values counted
+    uint64_t GetCount() const;
+    /**
+     * \param percentile the percentile, between 0 and 100
+     * \return the smallest delay that is greater than or equal to the given percentage of the
+     *         values, within 1.6%, 0 if the histogram is empty
+     */
+    Time GetPercentile(double percentile) const;
+    /// \return the largest delay counted, 0 if the histogram is empty
+    Time GetMax() const;
+
+    /**
+     * \return the histogram as a "max,index:count,..." string listing the non-empty buckets
+     */
+    std::string Serialize() const;
+    /**
+     * \param data the output of Serialize()
+     * \return the histogram
+     */
+    static DelayHistogram Deserialize(const std::string& data);
+
+  private:
+    static constexpr unsigned SUB_BUCKET_BITS = 6; //!< 2^6 = 64 linear buckets
+    static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr std::size_t N_BUCKETS =
+        SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * (SUB_BUCKETS / 2);
+
+    /**
+     * \param value a value in nanoseconds
+     * \return the index of the bucket of the value
+     */
+    static std::size_t GetIndex(uint64_t value);
+    /**
+     * \param index the index of a bucket
+     * \return the midpoint in nanoseconds of the bucket, rounded up
+     */
+    static uint64_t GetMidpoint(std::size_t index);
+
+    std::vector<uint64_t> m_counts; //!< N_BUCKETS entries, empty until a value is added
+    uint64_t m_count{0};
+    uint64_t m_max{0}; //!< nanoseconds
+};
+
+/**
+ * Collects the statistics of the flow of every station at its two endpoints only.
+ *
+ * Unlike FlowMonitor, which probes every IP layer of the network, the collector is attached to
+ * the traces of the client and server applications, and keeps a fixed set of counters per flow
+ * in an array indexed by station. The delay of a packet is computed from the timestamp of the
+ * SeqTs header added by the client (UdpClient, or OnOffApplication with the SeqTsSize header
+ * enabled).
+ */
+class EndpointFlowCollector
+{
+  public:
+    /// Counters of the flow of a station
+    struct FlowCounters
+    {
+        uint64_t txPackets{0};
+        uint64_t txBytes{0};
+        uint64_t rxPackets{0};
+        uint64_t rxBytes{0};
+        Time delaySum{0};
+        Time firstRx{0};
+        Time lastRx{0};
+        DelayHistogram delays;
+
+        /**
+         * Count a received packet.
+         *
+         * \param bytes the size of the packet
+         * \param sent the time the packet was sent
+         */
+        void Receive(uint32_t bytes, Time sent);
+    };
+
+    /**
+     * \param nStations the number of stations, each having one flow
+     */
+    explicit EndpointFlowCollector(std::size_t nStations);
+
+    /**
+     * Connect to the traces of the applications.
+     *
+     * \param clients the client application of each station
+     * \param servers the server application of each station
+     * \param udp whether the applications are UdpClient/UdpServer (OnOffApplication/PacketSink
+     *            otherwise)
+     */
+    void Install(const ApplicationContainer& clients, const ApplicationContainer& servers, bool udp);
+
+    /**
+     * \param station the index of the station
+     * \return the counters of the flow of the station
+     */
+    const FlowCounters& GetFlow(std::size_t station) const;
+
+  private:
+    /**
+     * Count a packet sent by a client.
+     *
+     * \param collector the collector
+     * \param station the index of the station
+     * \param packet the packet
+     */
+    static void NotifyTx(EndpointFlowCollector* collector,
+                         std::size_t station,
+                         Ptr<const Packet> packet);
+    /**
+     * Count a packet received by a UdpServer.
+     *
+     * \param collector the collector
+     * \param station the index of the station
+     * \param packet the packet, starting with its SeqTs header
+     */
+    static void NotifyUdpRx(EndpointFlowCollector* collector,
+                            std::size_t station,
+                            Ptr<const Packet> packet);
+    /**
+     * Count a packet received by a PacketSink.
+     *
+     * \param collector the collector
+     * \param station the index of the station
+     * \param packet the packet, without its SeqTsSize header
+     * \param from the sender address
+     * \param to the receiver address
+     * \param header the SeqTsSize header of the packet
+     */
+    static void NotifyTcpRx(EndpointFlowCollector* collector,
+                            std::size_t station,
+                            Ptr<const Packet> packet,
+                            const Address& from,
+                            const Address& to,
+                            const SeqTsSizeHeader& header);
+    std::vector<FlowCounters> m_flows;
+};
+
+/**
+ * Saturated traffic source feeding the MAC queues of the senders directly.
+ *
+ * Each sender (the AP in downlink, every station in uplink) gets frames of payloadSize bytes,
+ * starting with a SeqTs header, handed to its WifiNetDevice until its BE queue holds backlog
+ * MPDUs. Whenever the queue shrinks below the backlog, it is refilled, round robin over the
+ * receivers of the sender. The frames are counted by a protocol handler at the receiving devices,
+ * so the goodput is measured on top of the MAC layer.
+ */
+class MacSaturationSource
+{
+  public:
+    /**
+     * \param staAps the device of the AP of every station, the stations of a BSS being
+     *        contiguous
+     * \param staDevices the devices of the stations
+     * \param downlink whether the flows go from the AP to the stations
+     * \param payloadSize the size of the frame payloads
+     * \param backlog the number of MPDUs to keep in the BE queue of every sender
+     */
+    MacSaturationSource(const NetDeviceContainer& staAps,
+                        const NetDeviceContainer& staDevices,
+                        bool downlink,
+                        uint32_t payloadSize,
+                        uint32_t backlog);
+
+    /// Fill the queues and keep them filled
+    void Start();
+
+    /**
+     * \param station the index of the station
+     * \return the counters of the flow of the station
+     */
+    const EndpointFlowCollector::FlowCounters& GetFlow(std::size_t station) const;
+
+  private:
+    /// A device sending frames and the stations of its flows
+    struct Sender
+    {
+        Ptr<WifiNetDevice> device;
+        Ptr<WifiMacQueue> queue;
+        std::vector<std::size_t> stations; //!< indices of the stations of the flows
+        std::size_t next{0};               //!< position in stations of the next frame
+        bool refillScheduled{false};
+    };
+
+    /**
+     * Trace sink for the number of MPDUs in the queue of a sender.
+     *
+     * \param source the saturation source
+     * \param sender the index of the sender
+     * \param oldValue the previous number of MPDUs
+     * \param newValue the current number of MPDUs
+     */
+    static void NotifyQueueSize(MacSaturationSource* source,
+                                std::size_t sender,
+                                uint32_t oldValue,
+                                uint32_t newValue);
+    /**
+     * Protocol handler counting the frames received.
+     *
+     * \param source the saturation source
+     * \param device the receiving device
+     * \param packet the frame payload
+     * \param protocol the protocol number
+     * \param from the transmitter address
+     * \param to the receiver address
+     * \param packetType the packet type
+     */
+    static void NotifyRx(MacSaturationSource* source,
+                         Ptr<NetDevice> device,
+                         Ptr<const Packet> packet,
+                         uint16_t protocol,
+                         const Address& from,
+                         const Address& to,
+                         NetDevice::PacketType packetType);
+    /**
+     * Hand frames to a sender until its queue holds the backlog.
+     *
+     * \param sender the index of the sender
+     */
+    void Refill(std::size_t sender);
+
+    bool m_downlink;
+    uint32_t m_payloadSize;
+    uint32_t m_backlog;
+    std::vector<Sender> m_senders;
+    std::vector<Mac48Address> m_receivers;            //!< receiver of the flow of each station
+    std::map<Mac48Address, std::size_t> m_stationOf; //!< index of each station by address
+    std::vector<EndpointFlowCollector::FlowCounters> m_flows;
+};
+
+/**
+ * MAC and PHY counters of one direction of the link of a station, collected by
+ * MacPhyStatsCollector: the data MPDUs and PSDUs sent to the station by its AP and the PPDUs
+ * dropped by the PHY of the station (downlink), or the data MPDUs and PSDUs sent by the station
+ * (uplink).
+ */
+struct MacPhyCounters
+{
+    static constexpr std::size_t N_RU_TYPES = 7;            //!< RU types, 26 to 2x996 tones
+    static constexpr std::size_t N_DROP_REASONS = 4;        //!< values of WifiMacDropReason
+    static constexpr std::size_t N_RX_FAILURE_REASONS = 32; //!< bound of WifiPhyRxfailureReason
+
+    uint64_t txMpdus{0};     // data MPDUs transmitted, including the retransmissions
+    uint64_t retries{0};     // data MPDUs transmitted with the Retry flag set
+    uint64_t ackedMpdus{0};  // data MPDUs acknowledged
+    uint64_t nackedMpdus{0}; // transmissions of data MPDUs that were not acknowledged
+    uint64_t dataPsdus{0};   // PSDUs carrying data MPDUs (A-MPDUs and single MPDUs)
+    std::array<uint64_t, N_RU_TYPES> ruPsdus{};           // data PSDUs sent over an RU, by type
+    std::array<uint64_t, N_DROP_REASONS> droppedMpdus{};  // data MPDUs dropped by the MAC
+    std::array<uint64_t, N_RX_FAILURE_REASONS> rxDrops{}; // PPDUs dropped by the PHY
+
+    /**
+     * Add the counters of another link.
+     *
+     * \param other the counters to add
+     */
+    void Merge(const MacPhyCounters& other);
+
+    /**
+     * \return the counters as a ',' separated list of values, in the order of the fields
+     */
+    std::string Serialize() const;
+
+    /**
+     * \param data the output of Serialize()
+     * \return the counters
+     */
+    static MacPhyCounters Deserialize(const std::string& data);
+};
+
+/**
+ * Collects the MAC and PHY counters of every station from the trace sources of the WifiMac and
+ * WifiPhy of the stations and of the APs.
+ *
+ * The sinks are connected to the objects directly, bound to the index of their device, so that no
+ * configuration path is resolved per event, and update fixed counters in arrays indexed by
+ * station, one per direction: the frames sent by an AP count for the downlink of the station
+ * they are sent to (found from their receiver address), the frames sent by a station for its
+ * uplink. Under TCP, the uplink counters of a downlink flow thus hold the TCP acks. Nothing is
+ * counted before Start() is called, at the start of the measurement.
+ */
+class MacPhyStatsCollector
+{
+  public:
+    /**
+     * \param staAps the device of the AP of every station, the stations of a BSS being
+     *        contiguous
+     * \param staDevices the devices of the stations
+     */
+    MacPhyStatsCollector(const NetDeviceContainer& staAps, const NetDeviceContainer& staDevices);
+
+    /// Connect the sinks, which starts the counting
+    void Start();
+
+    /**
+     * \param station the index of the station
+     * \return the counters of the frames sent to the station
+     */
+    const MacPhyCounters& GetDownlink(std::size_t station) const;
+
+    /**
+     * \param station the index of the station
+     * \return the counters of the frames sent by the station
+     */
+    const MacPhyCounters& GetUplink(std::size_t station) const;
+
+    /**
+     * \return the number of stations
+     */
+    std::size_t GetNStations() const;
+
+    /**
+     * \return the counters of the APs, which only count the PPDUs dropped by their PHY
+     */
+    const MacPhyCounters& GetAps() const;
+
+  private:
+    /**
+     * Connect the sinks to the trace sources of a device.
+     *
+     * \param device the device
+     * \param index the index of the station, -1 for an AP
+     */
+    void Connect(Ptr<NetDevice> device, int32_t index);
+
+    /**
+     * \param device the index of the station whose device sent the frame, -1 for an AP
+     * \param receiver the receiver of the frame
+     * \return the uplink counters of the station that sent the frame, or the downlink counters
+     *         of the station it is sent to, nullptr if the frame is not sent to a station by an AP
+     */
+    MacPhyCounters* Find(int32_t device, Mac48Address receiver);
+
+    /**
+     * Trace sink for the PSDUs sent by a device.
+     *
+     * \param collector the collector
+     * \param device the index of the station, -1 for an AP
+     * \param psduMap the PSDU of every station addressed by the PPDU
+     * \param txVector the TXVECTOR of the PPDU
+     * \param txPowerW the transmit power
+     */
+    static void NotifyPsduTx(MacPhyStatsCollector* collector,
+                             int32_t device,
+                             WifiConstPsduMap psduMap,
+                             WifiTxVector txVector,
+                             double txPowerW);
+    /**
+     * Trace sink for the PPDUs dropped by the PHY of a device.
+     *
+     * \param collector the collector
+     * \param device the index of the station, -1 for an AP
+     * \param packet the dropped packet
+     * \param reason the reason of the drop
+     */
+    static void NotifyRxDrop(MacPhyStatsCollector* collector,
+                             int32_t device,
+                             Ptr<const Packet> packet,
+                             WifiPhyRxfailureReason reason);
+    /**
+     * Trace sink for the MPDUs acknowledged to a device.
+     *
+     * \param collector the collector
+     * \param device the index of the station, -1 for an AP
+     * \param mpdu the MPDU
+     */
+    static void NotifyAcked(MacPhyStatsCollector* collector,
+                            int32_t device,
+                            Ptr<const WifiMpdu> mpdu);
+    /**
+     * Trace sink for the MPDUs sent by a device and not acknowledged.
+     *
+     * \param collector the collector
+     * \param device the index of the station, -1 for an AP
+     * \param mpdu the MPDU
+     */
+    static void NotifyNAcked(MacPhyStatsCollector* collector,
+                             int32_t device,
+                             Ptr<const WifiMpdu> mpdu);
+    /**
+     * Trace sink for the MPDUs dropped by the MAC of a device.
+     *
+     * \param collector the collector
+     * \param device the index of the station, -1 for an AP
+     * \param reason the reason of the drop
+     * \param mpdu the MPDU
+     */
+    static void NotifyDropped(MacPhyStatsCollector* collector,
+                              int32_t device,
+                              WifiMacDropReason reason,
+                              Ptr<const WifiMpdu> mpdu);
+
+    NetDeviceContainer m_staAps;
+    NetDeviceContainer m_staDevices;
+    std::map<Mac48Address, std::size_t> m_stationOf; //!< index of each station by address
+    std::vector<MacPhyCounters> m_downlink;          //!< frames sent to each station
+    std::vector<MacPhyCounters> m_uplink;            //!< frames sent by each station
+    MacPhyCounters m_aps;
+};
+
+/**
+ * Multi-user scheduler of an AP building DL MU PPDUs with a proportional fair (pf) or
+ * max-weight (maxweight) policy.
+ *
+ * When the AP gains access to the channel, the candidates are its associated HE stations with a
+ * block ack agreement and a frame queued in the AC of the TXOP. Each candidate has an achievable
+ * rate, the rate of its data mode times the fraction of its MPDU transmissions acknowledged, and
+ * a backlog, the bytes of its data MPDUs queued and neither acknowledged nor dropped yet. Its
+ * weight is its backlog (maxweight) or the inverse of the moving average of its goodput (pf).
+ *
+ * The RU allocation is built greedily: the candidate with the largest weight times rate gets the
+ * whole channel, then, in the order of their weight times rate, every further candidate gets half
+ * of the RU whose split most increases the weighted bytes that a PPDU of the maximum duration
+ * delivers, the bytes of a station being bounded by its backlog, by its block ack window and by its
+ * achievable rate on its RU. The allocation stops when no split increases these weighted bytes or
+ * when NStations stations are served, so that the stations of large weight get the large RUs.
+ *
+ * Only DL MU PPDUs are scheduled: the scheduler never solicits TB PPDUs, and the frames that
+ * cannot be sent in a DL MU PPDU are sent in SU PPDUs.
+ */
+class WeightedMultiUserScheduler : public MultiUserScheduler
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /// Scheduling policy
+    enum Policy
+    {
+        PROPORTIONAL_FAIR,
+        MAX_WEIGHT
+    };
+
+  protected:
+    void DoInitialize() override;
+
+  private:
+    TxFormat SelectTxFormat() override;
+    DlMuInfo ComputeDlMuInfo() override;
+    UlMuInfo ComputeUlMuInfo() override;
+
+    /// Counters of the data MPDUs sent to a station
+    struct Flow
+    {
+        int64_t backlog{0};    //!< bytes enqueued and neither acknowledged nor dropped
+        uint64_t acked{0};     //!< MPDUs acknowledged
+        uint64_t nacked{0};    //!< transmissions of MPDUs that were not acknowledged
+        uint64_t ackedBits{0}; //!< bits acknowledged since the last goodput update
+        double goodput{0};     //!< moving average of the goodput (bit/s)
+        Time lastUpdate;       //!< time of the last goodput update
+    };
+
+    /// A station that may be served by the next DL MU PPDU
+    struct Candidate
+    {
+        uint16_t aid;
+        Mac48Address address;
+        Ptr<WifiMpdu> mpdu; //!< the first MPDU to send to the station
+        WifiMode mode;      //!< data mode of the station
+        uint8_t nss;        //!< number of spatial streams of the station
+        double maxBytes;    //!< bytes that a PSDU can carry to the station, given its backlog
+        double success;     //!< fraction of the MPDU transmissions acknowledged
+        double weight;
+        double priority;    //!< weight times achievable rate over the whole channel
+    };
+
+    /**
+     * \param candidate the candidate
+     * \param ru the RU of the candidate
+     * \return the bytes that a PPDU of the maximum duration delivers to the candidate on the RU
+     */
+    double GetBytes(const Candidate& candidate, const HeRu::RuSpec& ru) const;
+
+    /**
+     * Allocate the RUs of the channel to the candidates in decreasing order of priority.
+     *
+     * \param candidates the candidates
+     * \return the RU of every served candidate, in the order of the candidates
+     */
+    std::vector<HeRu::RuSpec> AllocateRus(const std::vector<Candidate>& candidates) const;
+
+    /**
+     * \param mpdu the MPDU
+     * \return the flow of the station the MPDU is sent to, nullptr if it is not a QoS data MPDU
+     *         sent to an associated station
+     */
+    Flow* Find(Ptr<const WifiMpdu> mpdu);
+
+    /**
+     * \param mpdu the MPDU enqueued
+     */
+    void NotifyEnqueue(Ptr<const WifiMpdu> mpdu);
+    /**
+     * \param mpdu the MPDU acknowledged
+     */
+    void NotifyAcked(Ptr<const WifiMpdu> mpdu);
+    /**
+     * \param mpdu the MPDU that was sent and not acknowledged
+     */
+    void NotifyNAcked(Ptr<const WifiMpdu> mpdu);
+    /**
+     * \param reason the reason of the drop
+     * \param mpdu the MPDU dropped
+     */
+    void NotifyDropped(WifiMacDropReason reason, Ptr<const WifiMpdu> mpdu);
+
+    Policy m_policy;
+    uint8_t m_nStations;                  //!< maximum number of stations served by a DL MU PPDU
+    Time m_averagingTime;                 //!< time constant of the moving average of the goodput
+    std::map<Mac48Address, Flow> m_flows; //!< flow of each station
+    std::vector<Candidate> m_served;      //!< stations served by the next DL MU PPDU
+    std::vector<HeRu::RuSpec> m_rus;      //!< RU of each of the served stations
+    WifiTxParameters m_txParams;          //!< TX parameters of the next DL MU PPDU
+};
+
+/**
+ * Writes the frames sent and received by a set of Wi-Fi devices to pcap files, with a radiotap
+ * header, at a bounded cost.
+ *
+ * The sinks are connected to the monitor sniffer trace sources of the PHYs, and fill the radiotap
+ * header from the TXVECTOR like WifiPhyHelper does (rate of the non-HT PPDUs, and format, MCS,
+ * BSS color, bandwidth or RU and guard interval of the HE PPDUs). Only the first snapLen bytes of
+ * a frame (by default the radiotap and MAC headers) are copied out of the packet, into a memory
+ * buffer per device that is written with a single write() once it holds 1 MiB; PcapFile would
+ * write every record through several stream calls instead. Every device has its own sequence of
+ * files, <prefix>-<name>-<n>.pcap: a new file is started when the current one would exceed
+ * maxFileSize bytes and at the start of every time window, even if no frame is captured in the
+ * window, and only the last maxFiles files are kept.
+ */
+class PcapCapture
+{
+  public:
+    /**
+     * \param prefix the prefix of the file names
+     * \param snapLen the number of bytes captured per frame, 0 to capture the whole frames
+     * \param maxFileSize the maximum size of a file in bytes, 0 for no limit
+     * \param window the duration of the time window of a file, 0 for no limit
+     * \param maxFiles the number of files kept per device, 0 to keep them all
+     */
+    PcapCapture(const std::string& prefix,
+                uint32_t snapLen,
+                uint64_t maxFileSize,
+                Time window,
+                uint32_t maxFiles);
+
+    /// Write the buffered frames and close the files
+    ~PcapCapture();
+
+    /**
+     * Capture the frames sent and received by a device.
+     *
+     * \param device the device
+     * \param name the name of the device in the file names
+     */
+    void Add(Ptr<NetDevice> device, const std::string& name);
+
+  private:
+    /// The sequence of files of a device
+    struct Output
+    {
+        std::string name;
+        int fd{-1};                    //!< descriptor of the current file, -1 if none
+        uint32_t nFiles{0};            //!< number of files started
+        uint64_t size{0};              //!< size of the current file, buffer included
+        std::string buffer;            //!< records not written yet
+        std::deque<std::string> paths; //!< files kept, the current one last
+    };
+
+    /**
+     * Trace sink for the frames sent by a device.
+     *
+     * \param capture the capture
+     * \param output the index of the output of the device
+     * \param packet the MPDU
+     * \param channelFreqMhz the frequency of the channel
+     * \param txVector the TXVECTOR of the PPDU
+     * \param aMpdu the position of the MPDU in its A-MPDU
+     * \param staId the station ID of the PSDU
+     */
+    static void NotifyTx(PcapCapture* capture,
+                         std::size_t output,
+                         Ptr<const Packet> packet,
+                         uint16_t channelFreqMhz,
+                         WifiTxVector txVector,
+                         MpduInfo aMpdu,
+                         uint16_t staId);
+    /**
+     * Trace sink for the frames received by a device.
+     *
+     * \param capture the capture
+     * \param output the index of the output of the device
+     * \param packet the MPDU
+     * \param channelFreqMhz the frequency of the channel
+     * \param txVector the TXVECTOR of the PPDU
+     * \param aMpdu the position of the MPDU in its A-MPDU
+     * \param signalNoise the signal and noise power
+     * \param staId the station ID of the PSDU
+     */
+    static void NotifyRx(PcapCapture* capture,
+                         std::size_t output,
+                         Ptr<const Packet> packet,
+                         uint16_t channelFreqMhz,
+                         WifiTxVector txVector,
+                         MpduInfo aMpdu,
+                         SignalNoiseDbm signalNoise,
+                         uint16_t staId);
+
+    /**
+     * \param channelFreqMhz the frequency of the channel
+     * \param txVector the TXVECTOR of the PPDU
+     * \param aMpdu the position of the MPDU in its A-MPDU
+     * \param staId the station ID of the PSDU
+     * \return the radiotap header of a frame, without the signal and noise power
+     */
+    static RadiotapHeader GetRadiotapHeader(uint16_t channelFreqMhz,
+                                            const WifiTxVector& txVector,
+                                            MpduInfo aMpdu,
+                                            uint16_t staId);
+
+    /**
+     * Append a frame to the output of a device.
+     *
+     * \param output the index of the output
+     * \param packet the MPDU
+     * \param header the radiotap header of the frame
+     */
+    void Write(std::size_t output, Ptr<const Packet> packet, const RadiotapHeader& header);
+
+    /**
+     * Close the current file of an output and start the next one.
+     *
+     * \param output the output
+     */
+    void Rotate(Output& output);
+
+    /// Start the next file of every output, at the start of a time window
+    void StartWindow();
+
+    /**
+     * Write the buffered records of an output to its file.
+     *
+     * \param output the output
+     */
+    void Flush(Output& output);
+
+    std::string m_prefix;
+    uint32_t m_snapLen;
+    uint64_t m_maxFileSize;
+    Time m_window;
+    uint32_t m_maxFiles;
+    std::vector<Output> m_outputs;
+    std::vector<uint8_t> m_frame; //!< bytes of the frame being written
+};
+
+/**
+ * Progress of the warm-up phase run by PreAssociate().
+ */
+struct WarmupState
+{
+    NetDeviceContainer senders;          //!< device sending the traffic of each flow
+    std::vector<Mac48Address> receivers; //!< MAC address of the receiver of each flow
+    std::vector<bool> associated;        //!< whether each station is associated
+    std::size_t nAssociated{0};          //!< number of associated stations
+    std::size_t nPrimed{0};              //!< number of flows whose priming frame was received
+};
+
+/**
+ * Statistics of one flow of a simulated scenario.
+ */
+struct FlowResult
+{
+    uint32_t flowId{0};
+    int32_t station{-1}; // index of the station, -1 if not a data flow (e.g. TCP acks)
+    std::string source;
+    std::string destination;
+    uint64_t txPackets{0};
+    uint64_t rxPackets{0};
+    uint64_t txBytes{0};
+    uint64_t rxBytes{0};
+    double delaySum{0}; // seconds
+    double firstRx{0};  // seconds, time the first packet was received
+    double lastRx{0};   // seconds, time the last packet was received
+    DelayHistogram delays; // empty if collected by FlowMonitor
+};
+
+/**
+ * Outcome of a single simulated scenario.
+ */
+struct ScenarioResult
+{
+    uint64_t rxBytes{0};
+    double throughput{0}; // Mbit/s
+    double duration{0};   // seconds of traffic the throughput is computed over
+    uint64_t txPackets{0};
+    uint64_t rxPackets{0};
+    double delay{0}; // mean delay in seconds
+    DelayHistogram delays; // delays of the data flows of all the stations
+    std::vector<FlowResult> flows;
+    std::vector<uint64_t> stationRxBytes; // bytes received by the server of each station
+    std::vector<MacPhyCounters> stationDlMacPhy; // counters of the frames sent to each station
+    std::vector<MacPhyCounters> stationUlMacPhy; // counters of the frames sent by each station
+    MacPhyCounters apMacPhy;                     // PHY counters of the APs
+    double setupTime{0}; // wall-clock seconds spent building the scenario (and warming it up)
+    double runTime{0};   // wall-clock seconds spent in the final Simulator::Run()
+    uint64_t events{0};  // number of events executed by the final Simulator::Run()
+    long peakRss{0};     // peak resident set size of the process in KiB
+};
+
+/**
+ * Goodput of a scenario estimated by the analytic model.
+ */
+struct AnalyticEstimate
+{
+    double goodput{0};              // Mbit/s, the capacity capped by the offered load
+    double capacity{0};             // Mbit/s, goodput of saturated senders
+    double offeredLoad{0};          // Mbit/s
+    double collisionProbability{0}; // probability that a transmission collides
+    uint32_t mpdusPerAmpdu{0};      // MPDUs aggregated in a transmission
+    double txDuration{0};           // seconds, duration of a successful transmission
+};
+
+/**
+ * Appends machine-readable records of the scenario results to a file, one record for the run and
+ * one per flow. Each scenario is written with a single write() under an exclusive lock, so that
+ * several processes can append to the same file without interleaving their records.
+ */
+struct ResultsSink
+{
+    std::string path;            //!< output file, no records are written if empty
+    std::string format{"csv"};   //!< csv or jsonl
+
+    void Append(const ScenarioConfig& config, const ScenarioResult& result) const;
+};
+
+/**
+ * On-disk cache of scenario results, keyed by a hash of everything that determines the result:
+ * every field of the scenario, the default value of every attribute and the value of every
+ * global value (which the ns-3 command line options may have changed), and the size and
+ * modification time of the program and of the ns-3 libraries it loaded.
+ *
+ * Each result is stored in its own file, named after the hash, which also holds the key to
+ * detect collisions; index.tsv lists the hash and the scenario of every entry. The scenarios
+ * writing a throughput time series are never cached, since a cache hit would not write it.
+ */
+struct ResultCache
+{
+    std::string dir;      //!< cache directory, the cache is disabled if empty
+    bool refresh{false};  //!< whether to ignore the cached results and overwrite them
+
+    /**
+     * \param config the scenario
+     * \param result the cached result, if any
+     * \return whether a result was found
+     */
+    bool Lookup(const ScenarioConfig& config, ScenarioResult& result) const;
+    /**
+     * \param config the scenario
+     * \param result its result
+     */
+    void Store(const ScenarioConfig& config, const ScenarioResult& result) const;
+};
+
+/**
+ * Search of the capacity of scenarios: the highest offered load (per BSS) at which the loss
+ * ratio and the 99th percentile of the delay stay below their thresholds.
+ *
+ * The search narrows an interval of loads around the knee of every scenario, from zero to an
+ * upper bound. Each round simulates in parallel loads evenly spread over the interval of every
+ * scenario, as many as there are workers, and keeps the interval between the highest sustainable
+ * load and the lowest unsustainable one, until it is narrower than tolerance times its upper
+ * bound (or 0.1 Mbit/s). Unless maxLoad is given, the upper bound comes from the analytic model
+ * and is doubled while it is sustainable, up to the PHY rate of the channel. The loss and the
+ * delay are assumed to grow with the offered load.
+ */
+struct CapacitySearch
+{
+    double maxLoss{0.01};            //!< highest sustainable loss ratio
+    Time maxDelay{MilliSeconds(50)}; //!< highest sustainable 99th percentile of the delay
+    double maxLoad{0};      //!< upper bound in Mbit/s, 0 to start from the capacity of the model
+    double tolerance{0.02}; //!< relative width of the final interval
 
+    /**
+     * \param result the result of a probe
+     * \return whether the offered load of the probe is sustainable
+     */
+    bool IsSustainable(const ScenarioResult& result) const;
+
+    /**
+     * Search the capacity of every scenario and print the knees.
+     *
+     * \param points the scenarios, whose load is ignored
+     * \param nWorkers the maximum number of concurrent worker processes
+     * \param sink the sink of the results of the probes
+     * \param cache the cache of the results of the probes
+     */
+    void Run(const std::vector<ScenarioConfig>& points,
+             uint32_t nWorkers,
+             const ResultsSink& sink,
+             const ResultCache& cache) const;
+};
+
+Ptr<StaWifiMac> GetFirstStaWifiMac(NodeContainer& sta);
+void PopulateARPcache ();
+void PlaceNodes(const ScenarioConfig& config,
+                Ptr<Node> apNode,
+                const Vector& apPosition,
+                const NodeContainer& staNodes,
+                int64_t stream);
+uint64_t GetRxBytes(const ApplicationContainer& servers, bool udp, uint32_t payloadSize);
+void ReportReplications(const std::vector<ScenarioResult>& results, std::size_t nStations);
+void ReportMacPhyCounters(const ScenarioResult& result);
+void RunBenchmark(const ScenarioConfig& base, const std::string& path);
+void CompareMuSchedulers(const std::vector<ScenarioConfig>& points,
+                         uint32_t nWorkers,
+                         const ResultsSink& sink,
+                         const ResultCache& cache);
+bool CheckExpectedThroughput(double lowest, double highest, double minExpected, double maxExpected);
+int ValidateGoldenTable(const ScenarioConfig& base,
+                        const std::string& path,
+                        uint32_t nWorkers,
+                        bool update,
+                        bool allowUnrecorded);
+double GetStudentT975(uint32_t degreesOfFreedom);
+AnalyticEstimate EstimateGoodput(const ScenarioConfig& config);
+void ProvisionBss(const NetDeviceContainer& devices);
+void PreAssociate(NetDeviceContainer staAps, NetDeviceContainer staDevices, bool downlink);
+ScenarioResult RunScenario(const ScenarioConfig& config);
+ScenarioResult RunMacSaturation(const ScenarioConfig& config,
+                                const NetDeviceContainer& staAps,
+                                const NetDeviceContainer& staDevices,
+                                std::chrono::steady_clock::time_point setupStart);
+void RunSimulation(ScenarioResult& result, std::chrono::steady_clock::time_point setupStart);
+template <class A>
+FlowResult GetFlowResult(uint32_t flowId,
+                         std::size_t station,
+                         const A& source,
+                         const A& destination,
+                         const EndpointFlowCollector::FlowCounters& counters);
+void FinishScenario(ScenarioResult& result, const MacPhyStatsCollector* macPhyStats);
+std::vector<ScenarioResult> RunScenarios(
+    const std::vector<ScenarioConfig>& configs,
+    uint32_t nWorkers,
+    const std::function<void(std::size_t, const ScenarioResult&)>& onResult = nullptr,
+    const ResultCache* cache = nullptr);
+std::string GetCanonicalConfig(const ScenarioConfig& config);
+const std::string& GetCacheEnvironment();
+std::vector<uint16_t> GetChannelPlan(const ScenarioConfig& config);
+std::set<std::string> ParsePcapDevices(const std::string& devices);
+std::vector<ScenarioConfig> PartitionBss(const ScenarioConfig& config);
+ScenarioResult MergePartitions(const std::vector<ScenarioConfig>& partitions,
+                               const std::vector<ScenarioResult>& results);
+bool WriteAll(int fd, const std::string& data);
+std::string AddFileSuffix(const std::string& path, const std::string& suffix);
+std::vector<ScenarioConfig> ParseGrid(const std::string& grid, const ScenarioConfig& base);
+std::string SerializeResult(const ScenarioResult& result);
+ScenarioResult DeserializeResult(const std::string& data);
+
+int
+main(int argc, char* argv[])
+{
+    ScenarioConfig config;
+    double minExpectedThroughput{0};
+    double maxExpectedThroughput{0};
+    std::string grid;
+    uint32_t workers{0};
+    uint32_t replications{1};
+    bool benchmark{false};
+    std::string benchmarkFile;
+    std::string goldenTable;
+    bool updateGolden{false};
+    bool allowUnrecorded{false};
+    bool analytic{false};
+    double prescreen{0};
+    bool capacitySearch{false};
+    CapacitySearch search;
+    bool compareMuSchedulers{false};
+    ResultsSink sink;
+    ResultCache cache;
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("frequency",
                  "Whether working in the 2.4, 5 or 6 GHz band (other values gets rejected)",
-                 frequency);
+                 config.frequency);
     cmd.AddValue("distance",
                  "Distance in meters between the station and the access point",
-                 distance);
-    cmd.AddValue("simulationTime", "Simulation time in seconds", simulationTime);
-    cmd.AddValue("udp", "UDP if set to 1, TCP otherwise", udp);
+                 config.distance);
+    cmd.AddValue("placement",
+                 "Placement of the stations around the AP: list (the first station at distance, "
+                 "the others alternately on the AP and on the first station), disc (evenly "
+                 "spaced on a circle of radius distance), grid (square grid with a spacing of "
+                 "distance) or random (uniformly in a disc of radius distance)",
+                 config.placement);
+    cmd.AddValue("cachePathLoss",
+                 "Precompute the path loss between every pair of nodes, which do not move",
+                 config.cachePathLoss);
+    cmd.AddValue("simulationTime", "Simulation time in seconds", config.simulationTime);
+    cmd.AddValue("udp", "UDP if set to 1, TCP otherwise", config.udp);
     cmd.AddValue("downlink",
                  "Generate downlink flows if set to 1, uplink flows otherwise",
-                 downlink);
-    cmd.AddValue("useRts", "Enable/disable RTS/CTS", useRts);
-    cmd.AddValue("useExtendedBlockAck", "Enable/disable use of extended BACK", useExtendedBlockAck);
-    cmd.AddValue("nStations", "Number of non-AP HE stations", nStations);
+                 config.downlink);
+    cmd.AddValue("useRts", "Enable/disable RTS/CTS", config.useRts);
+    cmd.AddValue("useExtendedBlockAck",
+                 "Enable/disable use of extended BACK",
+                 config.useExtendedBlockAck);
+    cmd.AddValue("nStations", "Number of non-AP HE stations of every BSS", config.nStations);
+    cmd.AddValue("nBss", "Number of BSSs, each with its AP and nStations stations", config.nBss);
+    cmd.AddValue("bssSpacing",
+                 "Distance in meters between neighboring APs, which are placed on a square grid",
+                 config.bssSpacing);
+    cmd.AddValue("channelPlan",
+                 "Comma separated operating channel numbers, given to the BSSs in turn (empty "
+                 "puts every BSS on the default channel). The BSSs on non-overlapping channels "
+                 "are simulated in parallel",
+                 config.channelPlan);
     cmd.AddValue("dlAckType",
                  "Ack sequence type for DL OFDMA (NO-OFDMA, ACK-SU-FORMAT, MU-BAR, AGGR-MU-BAR)",
-                 dlAckSeqType);
+                 config.dlAckSeqType);
     cmd.AddValue("enableUlOfdma",
                  "Enable UL OFDMA (useful if DL OFDMA is enabled and TCP is used)",
-                 enableUlOfdma);
+                 config.enableUlOfdma);
     cmd.AddValue("enableBsrp",
                  "Enable BSRP (useful if DL and UL OFDMA are enabled and TCP is used)",
-                 enableBsrp);
+                 config.enableBsrp);
+    cmd.AddValue("muScheduler",
+                 "MU scheduler used with DL OFDMA: rr (RrMultiUserScheduler), pf (proportional "
+                 "fair) or maxweight, the latter two choosing the stations of the DL MU PPDUs "
+                 "and the size of their RUs from their weight and achievable rate",
+                 config.muScheduler);
     cmd.AddValue(
         "muSchedAccessReqInterval",
         "Duration of the interval between two requests for channel access made by the MU scheduler",
-        accessReqInterval);
-    cmd.AddValue("mcs", "if set, limit testing to a specific MCS (0-11)", mcs);
-    cmd.AddValue("payloadSize", "The application payload size in bytes", payloadSize);
+        config.accessReqInterval);
+    cmd.AddValue("mcs", "if set, limit testing to a specific MCS (0-11)", config.mcs);
+    cmd.AddValue("channelWidth", "Channel width in MHz (20, 40, 80 or 160)", config.channelWidth);
+    cmd.AddValue("guardInterval",
+                 "Guard interval in nanoseconds (800, 1600 or 3200)",
+                 config.guardInterval);
+    cmd.AddValue("load",
+                 "Offered load in Mbit/s of the clients of a BSS, split evenly among its stations",
+                 config.load);
+    cmd.AddValue("burstSize",
+                 "Number of UDP packets sent at once by a client, every burstSize packet "
+                 "intervals. The mean offered load does not depend on it, but the packets of a "
+                 "burst arrive back to back, which changes the queueing and the delays",
+                 config.burstSize);
+    cmd.AddValue("payloadSize", "The application payload size in bytes", config.payloadSize);
     cmd.AddValue("phyModel",
                  "PHY model to use when OFDMA is disabled (Yans or Spectrum). If OFDMA is enabled "
                  "then Spectrum is automatically selected",
-                 phyModel);
+                 config.phyModel);
     cmd.AddValue("minExpectedThroughput",
                  "if set, simulation fails if the lowest throughput is below this value",
                  minExpectedThroughput);
     cmd.AddValue("maxExpectedThroughput",
                  "if set, simulation fails if the highest throughput is above this value",
                  maxExpectedThroughput);
-    cmd.AddValue ("RgnRun", "Create randomness in the simulation", RgnRun);
+    cmd.AddValue ("RgnRun", "Create randomness in the simulation", config.rngRun);
+    cmd.AddValue("seed", "Seed of the random number generator", config.seed);
+    cmd.AddValue("scheduler",
+                 "Event scheduler implementation (Map, Heap, List or Calendar)",
+                 config.scheduler);
+    cmd.AddValue("preAssociate",
+                 "Associate the stations and set up the block ack agreements before the traffic "
+                 "starts, instead of a fixed 1 s warm-up",
+                 config.preAssociate);
+    cmd.AddValue("globalRouting",
+                 "Use global routing and the per-node ARP provisioning instead of the on-link "
+                 "routes and the BSS-wide ARP cache",
+                 config.globalRouting);
+    cmd.AddValue("flowMonitor",
+                 "Collect the flow statistics with a FlowMonitor on every node instead of at the "
+                 "client and server applications only",
+                 config.flowMonitor);
+    cmd.AddValue("macPhyStats",
+                 "Count the MAC and PHY events of every station after the warm-up (MPDUs sent, "
+                 "retried, acked and dropped, A-MPDU length, RU sizes) and print them after "
+                 "single runs. Off by default, since the trace sinks slow down every run",
+                 config.macPhyStats);
+    cmd.AddValue("macSaturation",
+                 "Keep the MAC queues of the senders filled directly, without IP stack nor "
+                 "applications, and measure the goodput on top of the MAC layer",
+                 config.macSaturation);
+    cmd.AddValue("macBacklog",
+                 "Number of MPDUs kept in the BE queue of every sender in MAC saturation mode "
+                 "(smaller than the MaxSize of the WifiMacQueue)",
+                 config.macBacklog);
+    cmd.AddValue("sampleInterval",
+                 "If positive, sample the bytes received by every station with this period",
+                 config.sampleInterval);
+    cmd.AddValue("samplesFile", "Output file of the throughput samples", config.samplesFile);
+    cmd.AddValue("pcap",
+                 "If set, capture the frames of the devices selected by pcapDevices to pcap files "
+                 "with this prefix",
+                 config.pcapPrefix);
+    cmd.AddValue("pcapDevices",
+                 "Comma separated devices to capture: ap, covert, stations, all or station indices",
+                 config.pcapDevices);
+    cmd.AddValue("pcapSnapLen",
+                 "Bytes captured per frame, the default covers the radiotap and MAC headers (0 "
+                 "captures the whole frames)",
+                 config.pcapSnapLen);
+    cmd.AddValue("pcapFileSize",
+                 "Start a new pcap file when the current one reaches this size in MB (0 for no "
+                 "limit)",
+                 config.pcapFileSize);
+    cmd.AddValue("pcapWindow",
+                 "Start a new pcap file every pcapWindow of simulated time, even if no frame "
+                 "was captured in the window (0 for no limit)",
+                 config.pcapWindow);
+    cmd.AddValue("pcapMaxFiles",
+                 "Number of pcap files kept per device, the oldest ones being deleted (0 keeps "
+                 "them all)",
+                 config.pcapMaxFiles);
+    cmd.AddValue("steadyStateTolerance",
+                 "If positive, stop the simulation once the half-width of the 95% confidence "
+                 "interval of the goodput batch means is below this fraction of their mean",
+                 config.steadyStateTolerance);
+    cmd.AddValue("batchDuration",
+                 "Duration of a batch for the steady state detection",
+                 config.batchDuration);
+    cmd.AddValue("minBatches",
+                 "Minimum number of batches before the steady state detection may stop the run",
+                 config.minBatches);
+    cmd.AddValue("grid",
+                 "Sweep grid, e.g. \"mcs=0-11;width=20,40,80,160;gi=800,1600,3200;seed=1-3\". "
+                 "Dimensions left out keep the value of the corresponding option",
+                 grid);
+    cmd.AddValue("workers",
+                 "Number of worker processes used in sweep and replication modes (0 uses one "
+                 "per core)",
+                 workers);
+    cmd.AddValue("benchmark",
+                 "Measure the wall-clock time, event rate and memory of a fixed matrix of "
+                 "configurations and print them as JSON",
+                 benchmark);
+    cmd.AddValue("benchmarkFile",
+                 "If set, write the benchmark JSON to this file instead of stdout",
+                 benchmarkFile);
+    cmd.AddValue("validate",
+                 "Simulate every point of this golden table and fail if a goodput falls outside "
+                 "its tolerance",
+                 goldenTable);
+    cmd.AddValue("updateGolden",
+                 "With --validate, store the measured goodputs in the golden table instead of "
+                 "checking them",
+                 updateGolden);
+    cmd.AddValue("allowUnrecorded",
+                 "With --validate, only report the points of the golden table without a goodput "
+                 "instead of failing",
+                 allowUnrecorded);
+    cmd.AddValue("analytic",
+                 "Print the goodput estimated by the analytic model instead of simulating",
+                 analytic);
+    cmd.AddValue("prescreen",
+                 "In sweep mode, only simulate the points whose offered load is within this "
+                 "relative margin of the capacity estimated by the analytic model, or that use "
+                 "OFDMA; the other points take the estimate (0 simulates every point)",
+                 prescreen);
+    cmd.AddValue("capacitySearch",
+                 "Search the highest offered load per BSS (for the given configuration or every "
+                 "point of the grid) at which the loss and the 99th percentile of the delay stay "
+                 "below searchMaxLoss and searchMaxDelay",
+                 capacitySearch);
+    cmd.AddValue("searchMaxLoss", "Highest sustainable loss ratio", search.maxLoss);
+    cmd.AddValue("searchMaxDelay",
+                 "Highest sustainable 99th percentile of the delay",
+                 search.maxDelay);
+    cmd.AddValue("searchMaxLoad",
+                 "Upper bound of the capacity search in Mbit/s per BSS (0 starts from 1.5 times "
+                 "the capacity estimated by the analytic model and doubles the bound while it is "
+                 "sustainable, up to the PHY rate of the channel)",
+                 search.maxLoad);
+    cmd.AddValue("searchTolerance",
+                 "Relative width of the load interval at which the capacity search stops",
+                 search.tolerance);
+    cmd.AddValue("compareMuSchedulers",
+                 "Simulate the given configuration (or every point of the grid) with each MU "
+                 "scheduler and compare their goodput and delay percentiles",
+                 compareMuSchedulers);
+    cmd.AddValue("replications",
+                 "Number of independent replications, run with RgnRun, RgnRun + 1, ...",
+                 replications);
+    cmd.AddValue("resultsFile",
+                 "If set, append one record per run and per flow to this file",
+                 sink.path);
+    cmd.AddValue("resultsFormat", "Format of the results file (csv or jsonl)", sink.format);
+    cmd.AddValue("resultCache",
+                 "Directory of the result cache: the scenarios already simulated with the same "
+                 "parameters and build are not simulated again (empty disables the cache)",
+                 cache.dir);
+    cmd.AddValue("refreshCache",
+                 "Simulate every scenario even if its result is cached, and update the cache",
+                 cache.refresh);
     cmd.Parse(argc, argv);
+    if (!cache.dir.empty())
+    {
+        // the scenarios change attribute defaults with Config::SetDefault, the environment of
+        // the cache keys must be described before any of them is built
+        GetCacheEnvironment();
+    }
+
+    if (config.frequency != 6 && config.frequency != 5 && config.frequency != 2.4)
+    {
+        std::cout << "Wrong frequency value!" << std::endl;
+        return 0;
+    }
+
+    NS_ABORT_MSG_IF(sink.format != "csv" && sink.format != "jsonl",
+                    "Invalid results format (must be csv or jsonl)");
+
+    if (workers == 0)
+    {
+        workers = std::max<long>(sysconf(_SC_NPROCESSORS_ONLN), 1);
+    }
+
+    if (config.scheduler != "Map" && config.scheduler != "Heap" && config.scheduler != "List" &&
+        config.scheduler != "Calendar")
+    {
+        NS_ABORT_MSG("Invalid scheduler (must be Map, Heap, List or Calendar)");
+    }
+
+    if (config.placement != "list" && config.placement != "disc" && config.placement != "grid" &&
+        config.placement != "random")
+    {
+        NS_ABORT_MSG("Invalid placement (must be list, disc, grid or random)");
+    }
+
+    // every BSS has its own /24 subnet, and every station its own port
+    NS_ABORT_MSG_IF(config.nBss == 0 || config.nBss > 254, "The number of BSSs must be 1 to 254");
+    NS_ABORT_MSG_IF(config.nStations > 253, "A BSS can have at most 253 stations");
+    NS_ABORT_MSG_IF(config.nBss * config.nStations > 10000, "At most 10000 stations are supported");
+    GetChannelPlan(config);
+    ParsePcapDevices(config.pcapDevices);
+    NS_ABORT_MSG_IF(config.load <= 0, "The offered load must be positive");
+    NS_ABORT_MSG_IF(config.muScheduler != "rr" && config.muScheduler != "pf" &&
+                        config.muScheduler != "maxweight",
+                    "Invalid MU scheduler (must be rr, pf or maxweight)");
+    // DL OFDMA selects the Spectrum PHY model whatever phyModel
+    NS_ABORT_MSG_IF((config.muScheduler != "rr" || compareMuSchedulers) &&
+                        config.dlAckSeqType == "NO-OFDMA",
+                    "The MU schedulers need DL OFDMA (dlAckType other than NO-OFDMA)");
+    NS_ABORT_MSG_IF((config.muScheduler != "rr" || compareMuSchedulers) && config.enableUlOfdma,
+                    "The pf and maxweight MU schedulers only schedule DL MU PPDUs, UL OFDMA "
+                    "needs the rr scheduler");
+    NS_ABORT_MSG_IF(!config.pcapPrefix.empty() &&
+                        (benchmark || !goldenTable.empty() || capacitySearch ||
+                         compareMuSchedulers),
+                    "The capture is not available in benchmark, validation and search modes");
+
+    NS_ABORT_MSG_IF(config.macSaturation && (config.sampleInterval.IsStrictlyPositive() ||
+                                             config.steadyStateTolerance > 0),
+                    "Sampling and steady state detection need the server applications, which "
+                    "MAC saturation mode does not install");
+    NS_ABORT_MSG_IF(config.macSaturation && config.macBacklog == 0,
+                    "The MAC backlog must be positive");
+
+    if (!goldenTable.empty())
+    {
+        return ValidateGoldenTable(config, goldenTable, workers, updateGolden, allowUnrecorded);
+    }
+
+    if (benchmark)
+    {
+        RunBenchmark(config, benchmarkFile);
+        return 0;
+    }
+
+    if (analytic)
+    {
+        std::vector<ScenarioConfig> points =
+            (grid.empty() ? std::vector<ScenarioConfig>{config} : ParseGrid(grid, config));
+        std::cout << "mcs\tchannelWidth [MHz]\tGI [ns]\tgoodput [Mbit/s]\tcapacity [Mbit/s]"
+                  << "\tcollision probability\tMPDUs per A-MPDU" << std::endl;
+        for (const auto& point : points)
+        {
+            AnalyticEstimate estimate = EstimateGoodput(point);
+            std::cout << point.mcs << "\t" << point.channelWidth << "\t\t\t" << point.guardInterval
+                      << "\t" << estimate.goodput << "\t" << estimate.capacity << "\t"
+                      << estimate.collisionProbability << "\t" << estimate.mpdusPerAmpdu
+                      << std::endl;
+        }
+        return 0;
+    }
+
+    if (capacitySearch)
+    {
+        NS_ABORT_MSG_IF(config.flowMonitor || config.macSaturation,
+                        "The capacity search needs the delays collected at the applications");
+        NS_ABORT_MSG_IF(search.tolerance <= 0, "The search tolerance must be positive");
+        config.displayFlowStats = false;
+        config.showStats = false;
+        search.Run(grid.empty() ? std::vector<ScenarioConfig>{config} : ParseGrid(grid, config),
+                   workers,
+                   sink,
+                   cache);
+        return 0;
+    }
+
+    if (compareMuSchedulers)
+    {
+        config.displayFlowStats = false;
+        config.showStats = false;
+        CompareMuSchedulers(grid.empty() ? std::vector<ScenarioConfig>{config}
+                                         : ParseGrid(grid, config),
+                            workers,
+                            sink,
+                            cache);
+        return 0;
+    }
+
+    if (replications > 1)
+    {
+        NS_ABORT_MSG_IF(!grid.empty(),
+                        "Replications cannot be combined with a grid, sweep the seed instead");
+        config.displayFlowStats = false;
+        config.showStats = false;
+        std::vector<ScenarioConfig> runs(replications, config);
+        for (uint32_t r = 0; r < replications; r++)
+        {
+            runs[r].rngRun = config.rngRun + r;
+            // the concurrent runs must not write the same samples file
+            runs[r].samplesFile =
+                AddFileSuffix(config.samplesFile, "-run" + std::to_string(runs[r].rngRun));
+            if (!config.pcapPrefix.empty())
+            {
+                runs[r].pcapPrefix += "-run" + std::to_string(runs[r].rngRun);
+            }
+        }
+        std::vector<ScenarioResult> results =
+            RunScenarios(
+                runs,
+                workers,
+                [&](std::size_t i, const ScenarioResult& result) { sink.Append(runs[i], result); },
+                &cache);
+        ReportReplications(results, config.nBss * config.nStations);
+        return 0;
+    }
+
+    if (grid.empty())
+    {
+        ScenarioResult result;
+        if (cache.Lookup(config, result))
+        {
+            std::cout << "Cached result of a previous run" << std::endl;
+        }
+        else
+        {
+            // the independent partitions of a multi-BSS scenario are simulated in parallel
+            result = (PartitionBss(config).size() > 1 ? RunScenarios({config}, workers).front()
+                                                      : RunScenario(config));
+            cache.Store(config, result);
+        }
+        sink.Append(config, result);
+
+        std::cout << "mcs" << "\t\t\t" << "channelWidth [MHz]" << " \t\t\t" << "throughput [Mbit/s]" << std::endl;
+        std::cout << config.mcs << "\t\t\t" << config.channelWidth << "\t\t\t" << result.throughput << " Mbit/s" << std::endl;
+        if (result.delays.GetCount() > 0)
+        {
+            std::cout << "delay p50/p95/p99/max: "
+                      << result.delays.GetPercentile(50).GetSeconds() * 1000 << " / "
+                      << result.delays.GetPercentile(95).GetSeconds() * 1000 << " / "
+                      << result.delays.GetPercentile(99).GetSeconds() * 1000 << " / "
+                      << result.delays.GetMax().GetSeconds() * 1000 << " ms" << std::endl;
+        }
+        if (config.displayFlowStats && config.macPhyStats)
+        {
+            ReportMacPhyCounters(result);
+        }
+        return CheckExpectedThroughput(result.throughput,
+                                       result.throughput,
+                                       minExpectedThroughput,
+                                       maxExpectedThroughput)
+                   ? 0
+                   : 1;
+    }
+
+    config.displayFlowStats = false;
+    config.showStats = false;
+    std::vector<ScenarioConfig> points = ParseGrid(grid, config);
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        // each point writes its own samples file
+        points[i].samplesFile = AddFileSuffix(config.samplesFile, "-" + std::to_string(i));
+        if (!config.pcapPrefix.empty())
+        {
+            points[i].pcapPrefix += "-" + std::to_string(i);
+        }
+    }
+
+    // the points far from the knee of the model are not worth a simulation; the model only
+    // covers single user transmissions, the OFDMA points are always simulated
+    std::vector<AnalyticEstimate> estimates;
+    std::vector<ScenarioConfig> simulated;
+    std::vector<std::size_t> simulatedIndex(points.size(), points.size());
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        estimates.push_back(EstimateGoodput(points[i]));
+        const AnalyticEstimate& estimate = estimates.back();
+        if (prescreen <= 0 || points[i].dlAckSeqType != "NO-OFDMA" || points[i].enableUlOfdma ||
+            std::abs(estimate.offeredLoad - estimate.capacity) <= prescreen * estimate.capacity)
+        {
+            simulatedIndex[i] = simulated.size();
+            simulated.push_back(points[i]);
+        }
+    }
+    if (prescreen > 0)
+    {
+        std::cout << "Simulating " << simulated.size() << " of " << points.size()
+                  << " points, the others take the analytic estimate" << std::endl;
+    }
+
+    std::vector<ScenarioResult> results =
+        RunScenarios(
+            simulated,
+            workers,
+            [&](std::size_t i, const ScenarioResult& result) { sink.Append(simulated[i], result); },
+            &cache);
+
+    std::cout << "mcs" << "\t" << "channelWidth [MHz]" << "\t" << "GI [ns]" << "\t" << "seed"
+              << "\t" << "throughput [Mbit/s]" << "\t" << "model [Mbit/s]" << "\t"
+              << "model error" << std::endl;
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        std::cout << points[i].mcs << "\t" << points[i].channelWidth << "\t\t\t"
+                  << points[i].guardInterval << "\t" << points[i].seed << "\t";
+        if (simulatedIndex[i] == points.size())
+        {
+            std::cout << "-\t" << estimates[i].goodput << "\t-" << std::endl;
+            continue;
+        }
+        double throughput = results[simulatedIndex[i]].throughput;
+        std::cout << throughput << "\t" << estimates[i].goodput << "\t" << std::showpos
+                  << (throughput > 0 ? (estimates[i].goodput - throughput) / throughput * 100 : 0)
+                  << "%" << std::noshowpos << std::endl;
+    }
 
-    RngSeedManager::SetRun(RgnRun);
+    double lowest = std::numeric_limits<double>::max();
+    double highest = 0;
+    for (const auto& result : results)
+    {
+        lowest = std::min(lowest, result.throughput);
+        highest = std::max(highest, result.throughput);
+    }
+    return CheckExpectedThroughput(lowest, highest, minExpectedThroughput, maxExpectedThroughput)
+               ? 0
+               : 1;
+}
+
+/**
+ * Build, run and tear down one scenario.
+ *
+ * \param config the scenario parameters
+ * \return the measured goodput
+ */
+ScenarioResult
+RunScenario(const ScenarioConfig& config)
+{
+    auto setupStart = std::chrono::steady_clock::now();
+    ObjectFactory schedulerFactory;
+    schedulerFactory.SetTypeId("ns3::" + config.scheduler + "Scheduler");
+    Simulator::SetScheduler(schedulerFactory);
+
+    std::string dlAckSeqType = config.dlAckSeqType;
+    std::string phyModel = config.phyModel;
+    std::size_t nStations = config.nStations;
+    int channelWidth = config.channelWidth;
+    int mcs = config.mcs;
+    double simulationTime = config.simulationTime;
+    double frequency = config.frequency;
+    uint32_t payloadSize = config.payloadSize;
+    bool udp = config.udp;
+    bool downlink = config.downlink;
 
-    if (useRts)
+    RngSeedManager::SetSeed(config.seed);
+    RngSeedManager::SetRun(config.rngRun);
+
+    if (config.useRts)
     {
         Config::SetDefault("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue("0"));
         Config::SetDefault("ns3::WifiDefaultProtectionManager::EnableMuRts", BooleanValue(true));
@@ -193,16 +1833,28 @@ main(int argc, char* argv[])
         Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(payloadSize));
     }
 
+    // the BSSs simulated by this run, all of them unless the run is a partition of the scenario;
+    // the stations of the k-th BSS are the nodes k * nStations to (k + 1) * nStations - 1
+    std::vector<uint32_t> bssIds = config.bss;
+    for (uint32_t b = 0; bssIds.empty() && b < config.nBss; b++)
+    {
+        bssIds.push_back(b);
+    }
+    std::vector<uint16_t> channels = GetChannelPlan(config);
+    const std::size_t nBss = bssIds.size();
+    const std::size_t nAllStations = nBss * nStations;
+
     NodeContainer wifiStaNodes;
-    wifiStaNodes.Create(nStations);
-    NodeContainer wifiApNode;
-    wifiApNode.Create(1);
+    wifiStaNodes.Create(nAllStations);
+    NodeContainer wifiApNodes;
+    wifiApNodes.Create(nBss);
 
-    NetDeviceContainer apDevice;
+    NetDeviceContainer apDevices;
     NetDeviceContainer staDevices;
+    NetDeviceContainer staAps; // device of the AP of every station
     WifiMacHelper mac;
     WifiHelper wifi;
-    std::string channelStr("{0, " + std::to_string(channelWidth) + ", ");
+    std::string band;
     StringValue ctrlRate;
     auto nonHtRefRateMbps = HePhy::GetNonHtReferenceRate(mcs) / 1e6;
 
@@ -213,7 +1865,7 @@ main(int argc, char* argv[])
     {
         wifi.SetStandard(WIFI_STANDARD_80211ax);
         ctrlRate = StringValue(ossDataMode.str());
-        channelStr += "BAND_6GHZ, 0}";
+        band = "BAND_6GHZ";
         Config::SetDefault("ns3::LogDistancePropagationLossModel::ReferenceLoss",
                             DoubleValue(48));
     }
@@ -223,7 +1875,7 @@ main(int argc, char* argv[])
         std::ostringstream ossControlMode;
         ossControlMode << "OfdmRate" << nonHtRefRateMbps << "Mbps";
         ctrlRate = StringValue(ossControlMode.str());
-        channelStr += "BAND_5GHZ, 0}";
+        band = "BAND_5GHZ";
     }
     else if (frequency == 2.4)
     {
@@ -231,14 +1883,13 @@ main(int argc, char* argv[])
         std::ostringstream ossControlMode;
         ossControlMode << "ErpOfdmRate" << nonHtRefRateMbps << "Mbps";
         ctrlRate = StringValue(ossControlMode.str());
-        channelStr += "BAND_2_4GHZ, 0}";
+        band = "BAND_2_4GHZ";
         Config::SetDefault("ns3::LogDistancePropagationLossModel::ReferenceLoss",
                             DoubleValue(40));
     }
     else
     {
-        std::cout << "Wrong frequency value!" << std::endl;
-        return 0;
+        NS_ABORT_MSG("Wrong frequency value!");
     }
 
     wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
@@ -248,13 +1899,56 @@ main(int argc, char* argv[])
                                     ctrlRate);
     // Set guard interval and MPDU buffer size
     wifi.ConfigHeOptions("GuardInterval",
-                            TimeValue(NanoSeconds(800)),
+                            TimeValue(NanoSeconds(config.guardInterval)),
                             "MpduBufferSize",
-                            UintegerValue(useExtendedBlockAck ? 256 : 64));
+                            UintegerValue(config.useExtendedBlockAck ? 256 : 64));
 
-    Ssid ssid = Ssid("ns3-80211ax");
-
-    if (phyModel == "Spectrum")
+    // every BSS has its own SSID and operates on the channel given by the channel plan
+    auto installBss = [&](WifiPhyHelper& phy) {
+        for (std::size_t k = 0; k < nBss; k++)
+        {
+            uint32_t b = bssIds[k];
+            Ssid ssid = Ssid(config.nBss == 1 ? "ns3-80211ax" : "ns3-80211ax-" + std::to_string(b));
+            NodeContainer bssStaNodes;
+            for (std::size_t i = 0; i < nStations; i++)
+            {
+                bssStaNodes.Add(wifiStaNodes.Get(k * nStations + i));
+            }
+            phy.Set("ChannelSettings",
+                    StringValue("{" + std::to_string(channels[b]) + ", " +
+                                std::to_string(channelWidth) + ", " + band + ", 0}"));
+
+            mac.SetType("ns3::StaWifiMac",
+                        "Ssid",
+                        SsidValue(ssid),
+                        "ActiveProbing",
+                        BooleanValue(config.preAssociate || config.macSaturation));
+            staDevices.Add(wifi.Install(phy, mac, bssStaNodes));
+
+            mac.SetType("ns3::ApWifiMac",
+                        "EnableBeaconJitter",
+                        BooleanValue(false),
+                        "Ssid",
+                        SsidValue(ssid));
+            NetDeviceContainer apDevice = wifi.Install(phy, mac, wifiApNodes.Get(k));
+            apDevices.Add(apDevice);
+            for (std::size_t i = 0; i < nStations; i++)
+            {
+                staAps.Add(apDevice);
+            }
+        }
+    };
+
+    Ptr<PropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel>();
+    Ptr<StaticPropagationLossCache> lossCache;
+    if (config.cachePathLoss)
+    {
+        lossCache = CreateObject<StaticPropagationLossCache>();
+        lossCache->SetModel(lossModel);
+        lossModel = lossCache;
+    }
+
+    if (phyModel == "Spectrum")
     {
         /*
             * SingleModelSpectrumChannel cannot be used with 802.11ax because two
@@ -265,132 +1959,230 @@ main(int argc, char* argv[])
         Ptr<MultiModelSpectrumChannel> spectrumChannel =
             CreateObject<MultiModelSpectrumChannel>();
 
-        Ptr<LogDistancePropagationLossModel> lossModel =
-            CreateObject<LogDistancePropagationLossModel>();
         spectrumChannel->AddPropagationLossModel(lossModel);
 
         SpectrumWifiPhyHelper phy;
         phy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
         phy.SetChannel(spectrumChannel);
 
-        mac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid));
-        phy.Set("ChannelSettings", StringValue(channelStr));
-        staDevices = wifi.Install(phy, mac, wifiStaNodes);
-
-        if (dlAckSeqType != "NO-OFDMA")
+        if (dlAckSeqType != "NO-OFDMA" && config.muScheduler != "rr")
+        {
+            mac.SetMultiUserScheduler("ns3::WeightedMultiUserScheduler",
+                                      "Policy",
+                                      StringValue(config.muScheduler));
+        }
+        else if (dlAckSeqType != "NO-OFDMA")
         {
             mac.SetMultiUserScheduler("ns3::RrMultiUserScheduler",
                                         "EnableUlOfdma",
-                                        BooleanValue(enableUlOfdma),
+                                        BooleanValue(config.enableUlOfdma),
                                         "EnableBsrp",
-                                        BooleanValue(enableBsrp),
+                                        BooleanValue(config.enableBsrp),
                                         "AccessReqInterval",
-                                        TimeValue(accessReqInterval));
+                                        TimeValue(config.accessReqInterval));
         }
-        mac.SetType("ns3::ApWifiMac",
-                    "EnableBeaconJitter",
-                    BooleanValue(false),
-                    "Ssid",
-                    SsidValue(ssid));
-        apDevice = wifi.Install(phy, mac, wifiApNode);
+        installBss(phy);
     }
     else
     {
-        YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
+        // same models as YansWifiChannelHelper::Default()
+        Ptr<YansWifiChannel> channel = CreateObject<YansWifiChannel>();
+        channel->SetPropagationLossModel(lossModel);
+        channel->SetPropagationDelayModel(CreateObject<ConstantSpeedPropagationDelayModel>());
+
         YansWifiPhyHelper phy;
         phy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
-        phy.SetChannel(channel.Create());
-
-        mac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid));
-        phy.Set("ChannelSettings", StringValue(channelStr));
-        staDevices = wifi.Install(phy, mac, wifiStaNodes);
-
-        mac.SetType("ns3::ApWifiMac",
-                    "EnableBeaconJitter",
-                    BooleanValue(false),
-                    "Ssid",
-                    SsidValue(ssid));
-        apDevice = wifi.Install(phy, mac, wifiApNode);
+        phy.SetChannel(channel);
+        installBss(phy);
     }
 
-    RngSeedManager::SetSeed(1);
-    RngSeedManager::SetRun(1);
     int64_t streamNumber = 150;
-    streamNumber += wifi.AssignStreams(apDevice, streamNumber);
+    streamNumber += wifi.AssignStreams(apDevices, streamNumber);
     streamNumber += wifi.AssignStreams(staDevices, streamNumber);
 
-    Ptr<StaWifiMac> covertStaWifiMac = GetFirstStaWifiMac(wifiStaNodes);
-    covertStaWifiMac->SetCovertStatus (true);
-    
-    // mobility.
-    MobilityHelper mobility;
-    Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator>();
-
-    positionAlloc->Add(Vector(0.0, 0.0, 0.0));
-    positionAlloc->Add(Vector(distance, 0.0, 0.0));
-    mobility.SetPositionAllocator(positionAlloc);
+    // the devices are named after their index in the whole scenario
+    std::unique_ptr<PcapCapture> capture;
+    if (!config.pcapPrefix.empty())
+    {
+        capture = std::make_unique<PcapCapture>(config.pcapPrefix,
+                                                config.pcapSnapLen,
+                                                config.pcapFileSize * 1000000ULL,
+                                                config.pcapWindow,
+                                                config.pcapMaxFiles);
+        std::set<std::string> selection = ParsePcapDevices(config.pcapDevices);
+        for (std::size_t k = 0; k < nBss; k++)
+        {
+            if (selection.count("ap") > 0 || selection.count("all") > 0)
+            {
+                capture->Add(apDevices.Get(k), "ap" + std::to_string(bssIds[k]));
+            }
+        }
+        for (std::size_t i = 0; i < nAllStations; i++)
+        {
+            std::string station =
+                std::to_string(bssIds[i / nStations] * nStations + i % nStations);
+            if (selection.count(station) > 0 || selection.count("stations") > 0 ||
+                selection.count("all") > 0 || (station == "0" && selection.count("covert") > 0))
+            {
+                capture->Add(staDevices.Get(i), "sta" + station);
+            }
+        }
+    }
 
-    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    // the covert station is the first station of the first BSS
+    if (bssIds.front() == 0)
+    {
+        Ptr<StaWifiMac> covertStaWifiMac = GetFirstStaWifiMac(wifiStaNodes);
+        covertStaWifiMac->SetCovertStatus (true);
+    }
+    
+    // mobility: the APs are placed on a square grid, each BSS around its AP
+    auto apGridSide = static_cast<uint32_t>(std::ceil(std::sqrt(config.nBss)));
+    for (std::size_t k = 0; k < nBss; k++)
+    {
+        NodeContainer bssStaNodes;
+        for (std::size_t i = 0; i < nStations; i++)
+        {
+            bssStaNodes.Add(wifiStaNodes.Get(k * nStations + i));
+        }
+        Vector apPosition((bssIds[k] % apGridSide) * config.bssSpacing,
+                          (bssIds[k] / apGridSide) * config.bssSpacing,
+                          0.0);
+        PlaceNodes(config, wifiApNodes.Get(k), apPosition, bssStaNodes, streamNumber++);
+    }
+    if (lossCache)
+    {
+        lossCache->Build(NodeContainer(wifiApNodes, wifiStaNodes));
+    }
 
-    mobility.Install(wifiApNode);
-    mobility.Install(wifiStaNodes);
+    if (config.macSaturation)
+    {
+        return RunMacSaturation(config, staAps, staDevices, setupStart);
+    }
 
     /* Internet stack*/
     InternetStackHelper stack;
-    stack.Install(wifiApNode);
+    if (!config.globalRouting)
+    {
+        // the nodes of a BSS share one subnet, the on-link routes of the static routing suffice
+        Ipv4StaticRoutingHelper staticRouting;
+        stack.SetRoutingHelper(staticRouting);
+    }
+    stack.Install(wifiApNodes);
     stack.Install(wifiStaNodes);
 
+    // BSS b uses the subnet 192.168.(b + 1).0/24
     Ipv4AddressHelper address;
-    address.SetBase("192.168.1.0", "255.255.255.0");
     Ipv4InterfaceContainer staNodeInterfaces;
-    Ipv4InterfaceContainer apNodeInterface;
+    Ipv4InterfaceContainer apNodeInterfaces;
+    for (std::size_t k = 0; k < nBss; k++)
+    {
+        NetDeviceContainer bssStaDevices;
+        for (std::size_t i = 0; i < nStations; i++)
+        {
+            bssStaDevices.Add(staDevices.Get(k * nStations + i));
+        }
+        std::string subnet = "192.168." + std::to_string(bssIds[k] + 1) + ".0";
+        address.SetBase(subnet.c_str(), "255.255.255.0");
+        staNodeInterfaces.Add(address.Assign(bssStaDevices));
+        apNodeInterfaces.Add(address.Assign(NetDeviceContainer(apDevices.Get(k))));
+
+        if (!config.globalRouting)
+        {
+            NetDeviceContainer bssDevices;
+            bssDevices.Add(bssStaDevices);
+            bssDevices.Add(apDevices.Get(k));
+            ProvisionBss(bssDevices);
+        }
+    }
+
+    if (config.globalRouting)
+    {
+        Simulator::Schedule(Seconds(0), &Ipv4GlobalRoutingHelper::PopulateRoutingTables);
+        PopulateARPcache();
+    }
 
-    staNodeInterfaces = address.Assign(staDevices);
-    apNodeInterface = address.Assign(apDevice);
+    // Traffic starts after 1 s of warm-up, unless the stations are associated beforehand
+    Time trafficStart = Seconds(1.0);
+    if (config.preAssociate)
+    {
+        PreAssociate(staAps, staDevices, downlink);
+        trafficStart = Seconds(0);
+    }
+    Time trafficStop = trafficStart + Seconds(simulationTime);
+    Time measureStart = Simulator::Now() + trafficStart;
+    std::unique_ptr<MacPhyStatsCollector> macPhyStats;
+    if (config.macPhyStats)
+    {
+        macPhyStats = std::make_unique<MacPhyStatsCollector>(staAps, staDevices);
+        Simulator::Schedule(trafficStart, &MacPhyStatsCollector::Start, macPhyStats.get());
+    }
 
     /* Setting applications */
+    // every station has its own server application (on its own port when the servers are all
+    // installed on the AP), so that serverApp.Get(i) counts the traffic of station i
     ApplicationContainer serverApp;
-    auto serverNodes = downlink ? std::ref(wifiStaNodes) : std::ref(wifiApNode);
+    ApplicationContainer clientApps;
+    NodeContainer serverNodes;
     Ipv4InterfaceContainer serverInterfaces;
     NodeContainer clientNodes;
-    for (std::size_t i = 0; i < nStations; i++)
+    Ipv4InterfaceContainer clientInterfaces;
+    for (std::size_t i = 0; i < nAllStations; i++)
     {
-        serverInterfaces.Add(downlink ? staNodeInterfaces.Get(i)
-                                        : apNodeInterface.Get(0));
-        clientNodes.Add(downlink ? wifiApNode.Get(0) : wifiStaNodes.Get(i));
+        Ptr<Node> apNode = wifiApNodes.Get(i / nStations);
+        auto apInterface = apNodeInterfaces.Get(i / nStations);
+        serverNodes.Add(downlink ? wifiStaNodes.Get(i) : apNode);
+        serverInterfaces.Add(downlink ? staNodeInterfaces.Get(i) : apInterface);
+        clientNodes.Add(downlink ? apNode : wifiStaNodes.Get(i));
+        clientInterfaces.Add(downlink ? apInterface : staNodeInterfaces.Get(i));
     }
 
+    uint16_t port = udp ? 9 : 50000;
+    // the offered load of a BSS is split evenly among its stations
+    double stationRate = config.load * 1e6 / nStations; // bit/s
     if (udp)
     {
         // UDP flow
-        uint16_t port = 9;
-        UdpServerHelper server(port);
-        serverApp = server.Install(serverNodes.get());
+        for (std::size_t i = 0; i < nAllStations; i++)
+        {
+            UdpServerHelper server(port + i);
+            serverApp.Add(server.Install(serverNodes.Get(i)));
+        }
         serverApp.Start(Seconds(0.0));
-        serverApp.Stop(Seconds(simulationTime + 1));
+        serverApp.Stop(trafficStop);
 
-        for (std::size_t i = 0; i < nStations; i++)
+        for (std::size_t i = 0; i < nAllStations; i++)
         {
-            UdpClientHelper client(serverInterfaces.GetAddress(i), port);
-            client.SetAttribute("MaxPackets", UintegerValue (4294967295U));
-            client.SetAttribute("Interval", TimeValue (Seconds(timeInterval))); // packets/s
-            client.SetAttribute("PacketSize", UintegerValue (payloadSize));
-            ApplicationContainer clientApp = client.Install (clientNodes.Get(i));
-            clientApp.Start(Seconds(1.0));
-            clientApp.Stop(Seconds(simulationTime + 1));
+            Ptr<PooledUdpClient> client = CreateObject<PooledUdpClient>();
+            client->SetAttribute(
+                "Remote",
+                AddressValue(InetSocketAddress(serverInterfaces.GetAddress(i), port + i)));
+            client->SetAttribute("Interval", TimeValue(Seconds(payloadSize * 8 / stationRate)));
+            client->SetAttribute("PacketSize", UintegerValue(payloadSize));
+            client->SetAttribute("BurstSize", UintegerValue(config.burstSize));
+            clientNodes.Get(i)->AddApplication(client);
+            ApplicationContainer clientApp(client);
+            clientApp.Start(trafficStart);
+            clientApp.Stop(trafficStop);
+            clientApps.Add(clientApp);
         }
     }
     else
     {
         // TCP flow
-        uint16_t port = 50000;
-        Address localAddress(InetSocketAddress(Ipv4Address::GetAny(), port));
-        PacketSinkHelper packetSinkHelper("ns3::TcpSocketFactory", localAddress);
-        serverApp = packetSinkHelper.Install(serverNodes.get());
+        for (std::size_t i = 0; i < nAllStations; i++)
+        {
+            Address localAddress(InetSocketAddress(Ipv4Address::GetAny(), port + i));
+            PacketSinkHelper packetSinkHelper("ns3::TcpSocketFactory", localAddress);
+            // the SeqTsSize header timestamps the packets for the endpoint flow collector
+            packetSinkHelper.SetAttribute("EnableSeqTsSizeHeader",
+                                          BooleanValue(!config.flowMonitor));
+            serverApp.Add(packetSinkHelper.Install(serverNodes.Get(i)));
+        }
         serverApp.Start(Seconds(0.0));
-        serverApp.Stop(Seconds(simulationTime + 1));
+        serverApp.Stop(trafficStop);
 
-        for (std::size_t i = 0; i < nStations; i++)
+        for (std::size_t i = 0; i < nAllStations; i++)
         {
             OnOffHelper onoff("ns3::TcpSocketFactory", Ipv4Address::GetAny());
             onoff.SetAttribute("OnTime",
@@ -398,138 +2190,3412 @@ main(int argc, char* argv[])
             onoff.SetAttribute("OffTime",
                                 StringValue("ns3::ConstantRandomVariable[Constant=0]"));
             onoff.SetAttribute("PacketSize", UintegerValue(payloadSize));
-            onoff.SetAttribute("DataRate", DataRateValue(DataRate("300Mbps"))); // bit/s
+            onoff.SetAttribute("DataRate",
+                               DataRateValue(DataRate(static_cast<uint64_t>(stationRate))));
             AddressValue remoteAddress(
-                InetSocketAddress(serverInterfaces.GetAddress(i), port));
+                InetSocketAddress(serverInterfaces.GetAddress(i), port + i));
             onoff.SetAttribute("Remote", remoteAddress);
+            onoff.SetAttribute("EnableSeqTsSizeHeader", BooleanValue(!config.flowMonitor));
             ApplicationContainer clientApp = onoff.Install(clientNodes.Get(i));
-            clientApp.Start(Seconds(1.0));
-            clientApp.Stop(Seconds(simulationTime + 1));
+            clientApp.Start(trafficStart);
+            clientApp.Stop(trafficStop);
+            clientApps.Add(clientApp);
         }
     }
 
-    Simulator::Schedule(Seconds(0), &Ipv4GlobalRoutingHelper::PopulateRoutingTables);
-    PopulateARPcache();
-
     FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll ();
+    Ptr<FlowMonitor> monitor;
+    std::unique_ptr<EndpointFlowCollector> collector;
+    if (config.flowMonitor)
+    {
+        monitor = flowmon.InstallAll();
+    }
+    else
+    {
+        collector = std::make_unique<EndpointFlowCollector>(nAllStations);
+        collector->Install(clientApps, serverApp, udp);
+    }
 
-    Simulator::Stop(Seconds(simulationTime + 1));
-    Simulator::Run();
+    std::unique_ptr<ThroughputSampler> sampler;
+    if (config.sampleInterval.IsStrictlyPositive())
+    {
+        sampler = std::make_unique<ThroughputSampler>(serverApp,
+                                                      udp,
+                                                      payloadSize,
+                                                      config.sampleInterval,
+                                                      config.samplesFile);
+        sampler->Start(trafficStart);
+    }
+
+    std::unique_ptr<SteadyStateDetector> detector;
+    if (config.steadyStateTolerance > 0)
+    {
+        detector = std::make_unique<SteadyStateDetector>(serverApp,
+                                                         udp,
+                                                         payloadSize,
+                                                         config.batchDuration,
+                                                         config.minBatches,
+                                                         config.steadyStateTolerance);
+        detector->Start(trafficStart);
+    }
 
-    double throughput = 0.0;
-    double totalThroughput = 0.0;
-    double delay = 0.0;
-    //std::ofstream outputFile("output.csv", std::ios::app);
+    Simulator::Stop(trafficStop);
+    ScenarioResult result;
+    RunSimulation(result, setupStart);
 
-    uint64_t rxBytes = 0;
-    if (udp)
+    if (sampler)
+    {
+        sampler->Flush();
+    }
+
+    // the traffic may have been stopped early by the steady state detector
+    double duration = (Simulator::Now() - measureStart).GetSeconds();
+    if (config.showStats && duration < simulationTime)
+    {
+        std::cout << "Steady state reached after " << duration << " s" << std::endl;
+    }
+
+    uint64_t rxBytes = GetRxBytes(serverApp, udp, payloadSize);
+    double throughput_ = (rxBytes * 8) / (duration * 1000000.0); // Mbit/s
+
+    result.rxBytes = rxBytes;
+    result.throughput = throughput_;
+    result.duration = duration;
+    for (uint32_t i = 0; i < serverApp.GetN(); i++)
+    {
+        result.stationRxBytes.push_back(
+            GetRxBytes(ApplicationContainer(serverApp.Get(i)), udp, payloadSize));
+    }
+    if (monitor)
     {
-        for (uint32_t i = 0; i < serverApp.GetN(); i++)
+        monitor->CheckForLostPackets();
+        Ptr<Ipv4FlowClassifier> classifier =
+            DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
+        for (const auto& [flowId, flowStats] : monitor->GetFlowStats())
         {
-            rxBytes += payloadSize * DynamicCast<UdpServer>(serverApp.Get(i))->GetReceived();
+            Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(flowId);
+            FlowResult flow;
+            flow.flowId = flowId;
+            // the data flow of station i goes to port + i of its server (TCP acks flow backwards)
+            uint32_t station = t.destinationPort - port;
+            if (t.destinationPort >= port && station < nAllStations &&
+                t.destinationAddress == serverInterfaces.GetAddress(station))
+            {
+                flow.station = station;
+            }
+            std::ostringstream source;
+            source << t.sourceAddress;
+            flow.source = source.str();
+            std::ostringstream destination;
+            destination << t.destinationAddress;
+            flow.destination = destination.str();
+            flow.txPackets = flowStats.txPackets;
+            flow.rxPackets = flowStats.rxPackets;
+            flow.txBytes = flowStats.txBytes;
+            flow.rxBytes = flowStats.rxBytes;
+            flow.delaySum = flowStats.delaySum.GetSeconds();
+            flow.firstRx = flowStats.timeFirstRxPacket.GetSeconds();
+            flow.lastRx = flowStats.timeLastRxPacket.GetSeconds();
+            result.flows.push_back(flow);
         }
     }
     else
     {
-        for (uint32_t i = 0; i < serverApp.GetN(); i++)
+        for (std::size_t i = 0; i < nAllStations; i++)
         {
-            rxBytes += DynamicCast<PacketSink>(serverApp.Get(i))->GetTotalRx();
+            result.flows.push_back(GetFlowResult(i + 1,
+                                                 i,
+                                                 clientInterfaces.GetAddress(i),
+                                                 serverInterfaces.GetAddress(i),
+                                                 collector->GetFlow(i)));
         }
     }
-    double throughput_ = (rxBytes * 8) / (simulationTime * 1000000.0); // Mbit/s
+    FinishScenario(result, macPhyStats.get());
 
+    if (config.displayFlowStats && config.showStats)
+    {
+        for (const auto& flow : result.flows)
+        {
+            double throughput = (flow.rxBytes * 8) / (duration * 1000000.0); // Mbit/s
+            double delay = (flow.rxPackets > 0 ? flow.delaySum / flow.rxPackets : 0);
 
-    monitor->CheckForLostPackets ();
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier ());
-    FlowMonitor::FlowStatsContainer stats = monitor->GetFlowStats ();
+            std::cout << "+++++++++++++++++++++++++++++++++++++++++++++++++++" << "\n";
+            std::cout << "Flow " << flow.flowId << " (" << flow.source << " -> " << flow.destination << ")\n";
+            std::cout << "Throughput:  " <<  throughput  << " [Mbps]\n";
+            std::cout << "Tx Packets: " <<  flow.txPackets << " [Packets] \n";
+            std::cout << "Rx Packets: " <<  flow.rxPackets << " [Packets] \n";
+            std::cout << "Delay: " << delay * 1000 << " [ms]\n";
+            if (flow.delays.GetCount() > 0)
+            {
+                std::cout << "Delay p50/p95/p99/max: "
+                          << flow.delays.GetPercentile(50).GetSeconds() * 1000 << " / "
+                          << flow.delays.GetPercentile(95).GetSeconds() * 1000 << " / "
+                          << flow.delays.GetPercentile(99).GetSeconds() * 1000 << " / "
+                          << flow.delays.GetMax().GetSeconds() * 1000 << " [ms]\n";
+            }
+            std::cout << "Lost # 1: " <<  flow.txPackets - flow.rxPackets << " [Packets] \n";
+            std::cout << "+++++++++++++++++++++++++++++++++++++++++++++++++++" << "\n\n";
+        }
+    }
+    return result;
+}
 
-    if(displayFlowStats)
+ThroughputSampler::ThroughputSampler(const ApplicationContainer& servers,
+                                     bool udp,
+                                     uint32_t payloadSize,
+                                     Time interval,
+                                     const std::string& path,
+                                     std::size_t capacity)
+    : m_nStations(servers.GetN()),
+      m_payloadSize(payloadSize),
+      m_interval(interval),
+      m_capacity(capacity),
+      m_times(capacity),
+      m_bytes(capacity * servers.GetN())
+{
+    for (uint32_t i = 0; i < servers.GetN(); i++)
     {
-        for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
+        if (udp)
         {
-            if (i->first > 0)
-            {
-                Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
-                throughput = (rxBytes * 8) / (simulationTime * 1000000.0); // Mbit/s
-                delay = i->second.delaySum.GetSeconds () / i->second.rxPackets;
-                
-                totalThroughput = totalThroughput + throughput;
+            m_udpServers.push_back(DynamicCast<UdpServer>(servers.Get(i)));
+        }
+        else
+        {
+            m_packetSinks.push_back(DynamicCast<PacketSink>(servers.Get(i)));
+        }
+    }
 
-                if(showStats)
-                {
-                    std::cout << "+++++++++++++++++++++++++++++++++++++++++++++++++++" << "\n";
-                    std::cout << "Flow " << i->first << " (" << t.sourceAddress << " -> " << t.destinationAddress << ")\n";
-                    std::cout << "Throughput:  " <<  throughput  << " [Mbps]\n";
-                    std::cout << "Tx Packets: " <<  i->second.txPackets << " [Packets] \n";
-                    std::cout << "Rx Packets: " <<  i->second.rxPackets << " [Packets] \n";
-                    std::cout << "Delay: " << delay  << " [ms]\n";
-                    std::cout << "Lost # 1: " <<  i->second.txPackets - i->second.rxPackets << " [Packets] \n";
-                    std::cout << "+++++++++++++++++++++++++++++++++++++++++++++++++++" << "\n\n";
-                }
+    m_file.open(path, std::ios::out | std::ios::trunc);
+    NS_ABORT_MSG_IF(!m_file.is_open(), "Cannot open " << path);
+    m_file << "time";
+    for (std::size_t i = 0; i < m_nStations; i++)
+    {
+        m_file << ",sta" << i;
+    }
+    m_file << "\n";
+}
+
+void
+ThroughputSampler::Start(Time delay)
+{
+    m_start = Simulator::Now() + delay;
+    Simulator::Schedule(delay, &ThroughputSampler::Sample, this);
+}
+
+void
+ThroughputSampler::Sample()
+{
+    if (m_size == m_capacity)
+    {
+        Flush();
+    }
+
+    m_times[m_head] = (Simulator::Now() - m_start).GetSeconds();
+    uint64_t* bytes = &m_bytes[m_head * m_nStations];
+    for (std::size_t i = 0; i < m_udpServers.size(); i++)
+    {
+        bytes[i] = m_udpServers[i]->GetReceived() * m_payloadSize;
+    }
+    for (std::size_t i = 0; i < m_packetSinks.size(); i++)
+    {
+        bytes[i] = m_packetSinks[i]->GetTotalRx();
+    }
+    m_head = (m_head + 1) % m_capacity;
+    m_size++;
+
+    Simulator::Schedule(m_interval, &ThroughputSampler::Sample, this);
+}
+
+void
+ThroughputSampler::Flush()
+{
+    for (std::size_t k = (m_head + m_capacity - m_size) % m_capacity; m_size > 0;
+         k = (k + 1) % m_capacity, m_size--)
+    {
+        m_file << m_times[k];
+        for (std::size_t i = 0; i < m_nStations; i++)
+        {
+            m_file << "," << m_bytes[k * m_nStations + i];
+        }
+        m_file << "\n";
+    }
+    m_file.flush();
+}
+
+SteadyStateDetector::SteadyStateDetector(const ApplicationContainer& servers,
+                                         bool udp,
+                                         uint32_t payloadSize,
+                                         Time batchDuration,
+                                         uint32_t minBatches,
+                                         double tolerance)
+    : m_servers(servers),
+      m_udp(udp),
+      m_payloadSize(payloadSize),
+      m_batchDuration(batchDuration),
+      m_minBatches(std::max<uint32_t>(minBatches, 2)),
+      m_tolerance(tolerance)
+{
+}
+
+void
+SteadyStateDetector::Start(Time delay)
+{
+    Simulator::Schedule(delay + m_batchDuration, &SteadyStateDetector::EndBatch, this);
+}
+
+void
+SteadyStateDetector::EndBatch()
+{
+    uint64_t rxBytes = GetRxBytes(m_servers, m_udp, m_payloadSize);
+    double goodput = (rxBytes - m_lastRxBytes) * 8 / (m_batchDuration.GetSeconds() * 1e6);
+    m_lastRxBytes = rxBytes;
+
+    if (m_nBatches++ > 0)
+    {
+        m_sum += goodput;
+        m_sumSquares += goodput * goodput;
+    }
+
+    uint32_t n = m_nBatches - 1;
+    if (n >= m_minBatches)
+    {
+        double mean = m_sum / n;
+        double variance = std::max((m_sumSquares - n * mean * mean) / (n - 1), 0.0);
+        double halfWidth = GetStudentT975(n - 1) * std::sqrt(variance / n);
+        if (mean > 0 && halfWidth <= m_tolerance * mean)
+        {
+            NS_LOG_INFO("Steady state: " << mean << " +/- " << halfWidth << " Mbit/s over " << n
+                                         << " batches");
+            Simulator::Stop();
+            return;
+        }
+    }
+    Simulator::Schedule(m_batchDuration, &SteadyStateDetector::EndBatch, this);
+}
+
+NS_OBJECT_ENSURE_REGISTERED(StaticPropagationLossCache);
+
+TypeId
+StaticPropagationLossCache::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::StaticPropagationLossCache")
+                            .SetParent<PropagationLossModel>()
+                            .AddConstructor<StaticPropagationLossCache>();
+    return tid;
+}
+
+void
+StaticPropagationLossCache::SetModel(Ptr<PropagationLossModel> model)
+{
+    m_model = model;
+}
+
+void
+StaticPropagationLossCache::Build(const NodeContainer& nodes)
+{
+    m_nNodes = 0;
+    for (auto it = nodes.Begin(); it != nodes.End(); ++it)
+    {
+        m_nNodes = std::max<std::size_t>(m_nNodes, (*it)->GetId() + 1);
+    }
+
+    std::vector<Ptr<MobilityModel>> mobility(m_nNodes);
+    for (auto it = nodes.Begin(); it != nodes.End(); ++it)
+    {
+        mobility[(*it)->GetId()] = (*it)->GetObject<MobilityModel>();
+        NS_ABORT_MSG_IF(!mobility[(*it)->GetId()],
+                        "Node " << (*it)->GetId() << " has no mobility model");
+    }
+
+    // a NaN gain marks the pairs involving IDs that are not in the container
+    m_gain.assign(m_nNodes * m_nNodes, std::numeric_limits<double>::quiet_NaN());
+    for (std::size_t i = 0; i < m_nNodes; i++)
+    {
+        for (std::size_t j = 0; j < m_nNodes; j++)
+        {
+            if (i != j && mobility[i] && mobility[j])
+            {
+                m_gain[i * m_nNodes + j] = m_model->CalcRxPower(0, mobility[i], mobility[j]);
             }
         }
     }
+}
 
-    std::cout << "mcs" << "\t\t\t" << "channelWidth [MHz]" << " \t\t\t" << "throughput [Mbit/s]" << std::endl;
-    std::cout << mcs << "\t\t\t" << channelWidth << "\t\t\t" << throughput_ << " Mbit/s" << std::endl;
+double
+StaticPropagationLossCache::DoCalcRxPower(double txPowerDbm,
+                                          Ptr<MobilityModel> a,
+                                          Ptr<MobilityModel> b) const
+{
+    Ptr<Node> nodeA = a->GetObject<Node>();
+    Ptr<Node> nodeB = b->GetObject<Node>();
+    if (nodeA && nodeB && nodeA->GetId() < m_nNodes && nodeB->GetId() < m_nNodes)
+    {
+        double gain = m_gain[nodeA->GetId() * m_nNodes + nodeB->GetId()];
+        if (!std::isnan(gain))
+        {
+            return txPowerDbm + gain;
+        }
+    }
+    return m_model->CalcRxPower(txPowerDbm, a, b);
+}
 
-    Simulator::Destroy();
-    return 0;
+int64_t
+StaticPropagationLossCache::DoAssignStreams(int64_t stream)
+{
+    return m_model->AssignStreams(stream);
 }
 
-void PopulateARPcache () 
+/**
+ * Install a constant position mobility model on the AP, at the given position, and on the
+ * stations of its BSS, placed around it as requested by the configuration.
+ *
+ * \param config the scenario
+ * \param apNode the AP
+ * \param apPosition the position of the AP
+ * \param staNodes the stations
+ * \param stream the stream number of the random variable used by the random placement
+ */
+void
+PlaceNodes(const ScenarioConfig& config,
+           Ptr<Node> apNode,
+           const Vector& apPosition,
+           const NodeContainer& staNodes,
+           int64_t stream)
 {
-	Ptr<ArpCache> arp = CreateObject<ArpCache> ();
-	arp->SetAliveTimeout (Seconds (3600 * 24 * 365) );
+    Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator>();
+    // the positions below are relative to the AP
+    auto addPosition = [&](const Vector& offset) {
+        positionAlloc->Add(Vector(apPosition.x + offset.x, apPosition.y + offset.y, apPosition.z));
+    };
+    addPosition(Vector(0.0, 0.0, 0.0));
+    const std::size_t nStations = staNodes.GetN();
 
-	for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); ++i)
-	{
-		Ptr<Ipv4L3Protocol> ip = (*i)->GetObject<Ipv4L3Protocol> ();
-		NS_ASSERT (ip != nullptr);
-		ObjectVectorValue interfaces;
-		ip->GetAttribute ("InterfaceList", interfaces);
+    if (config.placement == "list")
+    {
+        addPosition(Vector(config.distance, 0.0, 0.0));
+    }
+    else if (config.placement == "disc")
+    {
+        for (std::size_t i = 0; i < nStations; i++)
+        {
+            double angle = 2 * M_PI * i / nStations;
+            addPosition(
+                Vector(config.distance * std::cos(angle), config.distance * std::sin(angle), 0.0));
+        }
+    }
+    else if (config.placement == "grid")
+    {
+        // the AP takes the center cell of the smallest square holding all the nodes
+        auto side = static_cast<std::size_t>(std::ceil(std::sqrt(nStations + 1.0)));
+        double offset = (side - 1) / 2.0;
+        for (std::size_t cell = 0, placed = 0; placed < nStations; cell++)
+        {
+            double x = (cell % side - offset) * config.distance;
+            double y = (cell / side - offset) * config.distance;
+            if (x == 0 && y == 0)
+            {
+                continue;
+            }
+            addPosition(Vector(x, y, 0.0));
+            placed++;
+        }
+    }
+    else
+    {
+        Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable>();
+        uniform->SetStream(stream);
+        for (std::size_t i = 0; i < nStations; i++)
+        {
+            // the square root makes the density uniform over the disc
+            double rho = config.distance * std::sqrt(uniform->GetValue());
+            double angle = uniform->GetValue(0, 2 * M_PI);
+            addPosition(Vector(rho * std::cos(angle), rho * std::sin(angle), 0.0));
+        }
+    }
 
-		for (ObjectVectorValue::Iterator j = interfaces.Begin (); j != interfaces.End (); j++)
-		{
-			Ptr<Ipv4Interface> ipIface = (*j).second->GetObject<Ipv4Interface> ();
-			NS_ASSERT (ipIface != nullptr);
-			Ptr<NetDevice> device = ipIface->GetDevice ();
-			NS_ASSERT (device != nullptr);
-			Mac48Address addr = Mac48Address::ConvertFrom (device->GetAddress () );
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator(positionAlloc);
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    mobility.Install(apNode);
+    mobility.Install(staNodes);
+}
 
-			for (uint32_t k = 0; k < ipIface->GetNAddresses (); k++)
-			{
-				Ipv4Address ipAddr = ipIface->GetAddress (k).GetLocal();
-				if (ipAddr == Ipv4Address::GetLoopback ())
-					continue;
+/**
+ * Simulate a scenario in MAC saturation mode, once its devices are installed.
+ *
+ * \param config the scenario
+ * \param staAps the device of the AP of every station
+ * \param staDevices the devices of the stations
+ * \param setupStart the wall-clock time at which the setup of the scenario started
+ * \return the result of the scenario
+ */
+ScenarioResult
+RunMacSaturation(const ScenarioConfig& config,
+                 const NetDeviceContainer& staAps,
+                 const NetDeviceContainer& staDevices,
+                 std::chrono::steady_clock::time_point setupStart)
+{
+    // frames handed to a station that is not associated yet are dropped
+    PreAssociate(staAps, staDevices, config.downlink);
+    Time measureStart = Simulator::Now();
+    std::unique_ptr<MacPhyStatsCollector> macPhyStats;
+    if (config.macPhyStats)
+    {
+        macPhyStats = std::make_unique<MacPhyStatsCollector>(staAps, staDevices);
+        macPhyStats->Start();
+    }
 
-				ArpCache::Entry *entry = arp->Add (ipAddr);
-				Ipv4Header ipv4Hdr;
-				ipv4Hdr.SetDestination (ipAddr);
-				Ptr<Packet> p = Create<Packet> (100);
-				entry->MarkWaitReply (ArpCache::Ipv4PayloadHeaderPair (p, ipv4Hdr));
-				entry->MarkAlive (addr);
-			}
-		}
-	}
+    MacSaturationSource source(staAps,
+                               staDevices,
+                               config.downlink,
+                               config.payloadSize,
+                               config.macBacklog);
+    source.Start();
 
-	for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); ++i)
-	{
-		Ptr<Ipv4L3Protocol> ip = (*i)->GetObject<Ipv4L3Protocol> ();
-		NS_ASSERT (ip != nullptr);
-		ObjectVectorValue interfaces;
-		ip->GetAttribute ("InterfaceList", interfaces);
+    Simulator::Stop(Seconds(config.simulationTime));
+    ScenarioResult result;
+    RunSimulation(result, setupStart);
 
-		for (ObjectVectorValue::Iterator j = interfaces.Begin (); j != interfaces.End (); j ++)
-		{
-			Ptr<Ipv4Interface> ipIface = (*j).second->GetObject<Ipv4Interface> ();
-			ipIface->SetAttribute ("ArpCache", PointerValue (arp) );
-		}
-	}
+    result.duration = (Simulator::Now() - measureStart).GetSeconds();
+    for (std::size_t i = 0; i < staDevices.GetN(); i++)
+    {
+        Mac48Address sta = Mac48Address::ConvertFrom(staDevices.Get(i)->GetAddress());
+        Mac48Address ap = Mac48Address::ConvertFrom(staAps.Get(i)->GetAddress());
+        result.flows.push_back(GetFlowResult(i + 1,
+                                             i,
+                                             config.downlink ? ap : sta,
+                                             config.downlink ? sta : ap,
+                                             source.GetFlow(i)));
+        result.stationRxBytes.push_back(result.flows.back().rxBytes);
+        result.rxBytes += result.flows.back().rxBytes;
+    }
+    result.throughput = (result.rxBytes * 8) / (result.duration * 1000000.0); // Mbit/s
+    FinishScenario(result, macPhyStats.get());
+    return result;
 }
 
-Ptr<StaWifiMac> GetFirstStaWifiMac(NodeContainer& ap)
+/**
+ * Run the simulation until it stops, and record in the result the wall-clock setup and run
+ * times, the events executed by the run and the peak memory of the process.
+ *
+ * \param result the result of the scenario
+ * \param setupStart the wall-clock time at which the setup of the scenario started
+ */
+void
+RunSimulation(ScenarioResult& result, std::chrono::steady_clock::time_point setupStart)
+{
+    auto runStart = std::chrono::steady_clock::now();
+    uint64_t setupEvents = Simulator::GetEventCount();
+    Simulator::Run();
+    auto runEnd = std::chrono::steady_clock::now();
+
+    result.setupTime = std::chrono::duration<double>(runStart - setupStart).count();
+    result.runTime = std::chrono::duration<double>(runEnd - runStart).count();
+    result.events = Simulator::GetEventCount() - setupEvents;
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        result.peakRss = usage.ru_maxrss;
+    }
+}
+
+/**
+ * \param flowId the identifier of the flow
+ * \param station the index of the station of the flow
+ * \param source the address of the sender
+ * \param destination the address of the receiver
+ * \param counters the counters of the flow
+ * \return the result of the flow
+ */
+template <class A>
+FlowResult
+GetFlowResult(uint32_t flowId,
+              std::size_t station,
+              const A& source,
+              const A& destination,
+              const EndpointFlowCollector::FlowCounters& counters)
+{
+    FlowResult flow;
+    flow.flowId = flowId;
+    flow.station = station;
+    std::ostringstream oss;
+    oss << source;
+    flow.source = oss.str();
+    oss.str("");
+    oss << destination;
+    flow.destination = oss.str();
+    flow.txPackets = counters.txPackets;
+    flow.rxPackets = counters.rxPackets;
+    flow.txBytes = counters.txBytes;
+    flow.rxBytes = counters.rxBytes;
+    flow.delaySum = counters.delaySum.GetSeconds();
+    flow.firstRx = counters.firstRx.GetSeconds();
+    flow.lastRx = counters.lastRx.GetSeconds();
+    flow.delays = counters.delays;
+    return flow;
+}
+
+/**
+ * Complete the result of a scenario whose simulation is over, and destroy the simulation: add
+ * the data flows of the stations to the totals of the result, and record the MAC and PHY
+ * counters.
+ *
+ * \param result the result of the scenario, with its flows
+ * \param macPhyStats the MAC and PHY counters of the scenario, or null if they are not collected
+ */
+void
+FinishScenario(ScenarioResult& result, const MacPhyStatsCollector* macPhyStats)
+{
+    double delaySum = 0;
+    for (const auto& flow : result.flows)
+    {
+        if (flow.station >= 0)
+        {
+            result.txPackets += flow.txPackets;
+            result.rxPackets += flow.rxPackets;
+            delaySum += flow.delaySum;
+            result.delays.Merge(flow.delays);
+        }
+    }
+    result.delay = (result.rxPackets > 0 ? delaySum / result.rxPackets : 0);
+    if (macPhyStats)
+    {
+        for (std::size_t i = 0; i < macPhyStats->GetNStations(); i++)
+        {
+            result.stationDlMacPhy.push_back(macPhyStats->GetDownlink(i));
+            result.stationUlMacPhy.push_back(macPhyStats->GetUplink(i));
+        }
+        result.apMacPhy = macPhyStats->GetAps();
+    }
+
+    Simulator::Destroy();
+}
+
+/// Protocol number of the frames of the MAC saturation mode (local experimental Ethertype)
+static const uint16_t SATURATION_PROTOCOL = 0x88B6;
+
+MacSaturationSource::MacSaturationSource(const NetDeviceContainer& staAps,
+                                         const NetDeviceContainer& staDevices,
+                                         bool downlink,
+                                         uint32_t payloadSize,
+                                         uint32_t backlog)
+    : m_downlink(downlink),
+      m_payloadSize(payloadSize),
+      m_backlog(backlog),
+      m_flows(staDevices.GetN())
+{
+    Node::ProtocolHandler handler = MakeBoundCallback(&NotifyRx, this);
+    for (uint32_t i = 0; i < staDevices.GetN(); i++)
+    {
+        m_stationOf[Mac48Address::ConvertFrom(staDevices.Get(i)->GetAddress())] = i;
+        Ptr<NetDevice> sender = downlink ? staAps.Get(i) : staDevices.Get(i);
+        Ptr<NetDevice> receiver = downlink ? staDevices.Get(i) : staAps.Get(i);
+        m_receivers.push_back(Mac48Address::ConvertFrom(receiver->GetAddress()));
+        bool firstOfBss = (i == 0 || staAps.Get(i) != staAps.Get(i - 1));
+        if (downlink || firstOfBss)
+        {
+            receiver->GetNode()->RegisterProtocolHandler(handler, SATURATION_PROTOCOL, receiver);
+        }
+        if (!downlink || firstOfBss)
+        {
+            Sender entry;
+            entry.device = DynamicCast<WifiNetDevice>(sender);
+            entry.queue = entry.device->GetMac()->GetTxopQueue(AC_BE);
+            // the queue must have room for the frames handed while it is refilled
+            NS_ABORT_MSG_IF(backlog >= entry.queue->GetMaxSize().GetValue(),
+                            "The MAC backlog must be smaller than the size of the BE queue ("
+                                << entry.queue->GetMaxSize() << ")");
+            m_senders.push_back(entry);
+        }
+        m_senders.back().stations.push_back(i);
+    }
+}
+
+void
+MacSaturationSource::Start()
+{
+    for (std::size_t i = 0; i < m_senders.size(); i++)
+    {
+        m_senders[i].queue->TraceConnectWithoutContext("PacketsInQueue",
+                                                       MakeBoundCallback(&NotifyQueueSize, this, i));
+        Refill(i);
+    }
+}
+
+const EndpointFlowCollector::FlowCounters&
+MacSaturationSource::GetFlow(std::size_t station) const
+{
+    return m_flows.at(station);
+}
+
+void
+MacSaturationSource::NotifyQueueSize(MacSaturationSource* source,
+                                     std::size_t sender,
+                                     uint32_t oldValue,
+                                     uint32_t newValue)
+{
+    Sender& entry = source->m_senders[sender];
+    // the queue must not be modified while it is notifying a change
+    if (newValue < source->m_backlog && !entry.refillScheduled)
+    {
+        entry.refillScheduled = true;
+        Simulator::ScheduleNow(&MacSaturationSource::Refill, source, sender);
+    }
+}
+
+void
+MacSaturationSource::Refill(std::size_t sender)
+{
+    Sender& entry = m_senders[sender];
+    entry.refillScheduled = false;
+    uint32_t nPackets = entry.queue->GetNPackets();
+    // a frame may be dropped rather than queued, never try more than the missing count
+    for (uint32_t i = nPackets; i < m_backlog; i++)
+    {
+        std::size_t station = entry.stations[entry.next];
+        entry.next = (entry.next + 1) % entry.stations.size();
+
+        SeqTsHeader seqTs;
+        seqTs.SetSeq(m_flows[station].txPackets);
+        Ptr<Packet> packet = Create<Packet>(m_payloadSize - seqTs.GetSerializedSize());
+        packet->AddHeader(seqTs);
+        if (entry.device->Send(packet, m_receivers[station], SATURATION_PROTOCOL))
+        {
+            m_flows[station].txPackets++;
+            m_flows[station].txBytes += m_payloadSize;
+        }
+    }
+}
+
+void
+MacSaturationSource::NotifyRx(MacSaturationSource* source,
+                              Ptr<NetDevice> device,
+                              Ptr<const Packet> packet,
+                              uint16_t protocol,
+                              const Address& from,
+                              const Address& to,
+                              NetDevice::PacketType packetType)
+{
+    auto it = source->m_stationOf.find(Mac48Address::ConvertFrom(source->m_downlink ? to : from));
+    if (it == source->m_stationOf.end())
+    {
+        return;
+    }
+
+    SeqTsHeader seqTs;
+    packet->PeekHeader(seqTs);
+    source->m_flows[it->second].Receive(packet->GetSize(), seqTs.GetTs());
+}
+
+NS_OBJECT_ENSURE_REGISTERED(PooledUdpClient);
+
+TypeId
+PooledUdpClient::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::PooledUdpClient")
+            .SetParent<Application>()
+            .AddConstructor<PooledUdpClient>()
+            .AddAttribute("Remote",
+                          "The address and port of the destination",
+                          AddressValue(),
+                          MakeAddressAccessor(&PooledUdpClient::m_peer),
+                          MakeAddressChecker())
+            .AddAttribute("Interval",
+                          "The time between two packets",
+                          TimeValue(Seconds(1.0)),
+                          MakeTimeAccessor(&PooledUdpClient::m_interval),
+                          MakeTimeChecker())
+            .AddAttribute("PacketSize",
+                          "Size of the packets, including the SeqTs header",
+                          UintegerValue(1024),
+                          MakeUintegerAccessor(&PooledUdpClient::m_size),
+                          MakeUintegerChecker<uint32_t>(12, 65507))
+            .AddAttribute("BurstSize",
+                          "Number of packets sent at once",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&PooledUdpClient::m_burstSize),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddTraceSource("Tx",
+                            "A packet is sent",
+                            MakeTraceSourceAccessor(&PooledUdpClient::m_txTrace),
+                            "ns3::Packet::TracedCallback");
+    return tid;
+}
+
+void
+PooledUdpClient::StartApplication()
+{
+    NS_ABORT_MSG_IF(!m_interval.IsStrictlyPositive(), "The packet interval must be positive");
+
+    m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    NS_ABORT_MSG_IF(m_socket->Bind() != 0, "Cannot bind the socket");
+    m_socket->Connect(m_peer);
+    m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+
+    SeqTsHeader seqTs;
+    m_payload = Create<Packet>(m_size - seqTs.GetSerializedSize());
+
+    // the application was initialized m_startTime ago, the stop time is relative to that
+    m_nextTx = Simulator::Now();
+    m_stopTx = (m_stopTime.IsZero() ? Time::Max() : Simulator::Now() - m_startTime + m_stopTime);
+    m_sendEvent = Simulator::ScheduleNow(&PooledUdpClient::SendBurst, this);
+}
+
+void
+PooledUdpClient::StopApplication()
+{
+    Simulator::Cancel(m_sendEvent);
+    if (m_socket)
+    {
+        m_socket->Close();
+    }
+}
+
+void
+PooledUdpClient::SendBurst()
+{
+    for (uint32_t i = 0; i < m_burstSize && m_nextTx < m_stopTx; i++)
+    {
+        Ptr<Packet> packet = m_payload->Copy();
+        SeqTsHeader seqTs;
+        seqTs.SetSeq(m_sent);
+        packet->AddHeader(seqTs);
+        if (m_socket->Send(packet) >= 0)
+        {
+            m_txTrace(packet);
+            m_sent++;
+        }
+        m_nextTx += m_interval;
+    }
+    if (m_nextTx < m_stopTx)
+    {
+        m_sendEvent =
+            Simulator::Schedule(m_nextTx - Simulator::Now(), &PooledUdpClient::SendBurst, this);
+    }
+}
+
+EndpointFlowCollector::EndpointFlowCollector(std::size_t nStations)
+    : m_flows(nStations)
+{
+}
+
+void
+EndpointFlowCollector::Install(const ApplicationContainer& clients,
+                               const ApplicationContainer& servers,
+                               bool udp)
+{
+    for (std::size_t i = 0; i < m_flows.size(); i++)
+    {
+        clients.Get(i)->TraceConnectWithoutContext("Tx",
+                                                   MakeBoundCallback(&NotifyTx, this, i));
+        if (udp)
+        {
+            servers.Get(i)->TraceConnectWithoutContext("Rx",
+                                                       MakeBoundCallback(&NotifyUdpRx, this, i));
+        }
+        else
+        {
+            servers.Get(i)->TraceConnectWithoutContext("RxWithSeqTsSize",
+                                                       MakeBoundCallback(&NotifyTcpRx, this, i));
+        }
+    }
+}
+
+const EndpointFlowCollector::FlowCounters&
+EndpointFlowCollector::GetFlow(std::size_t station) const
+{
+    return m_flows.at(station);
+}
+
+void
+EndpointFlowCollector::NotifyTx(EndpointFlowCollector* collector,
+                                std::size_t station,
+                                Ptr<const Packet> packet)
+{
+    FlowCounters& flow = collector->m_flows[station];
+    flow.txPackets++;
+    flow.txBytes += packet->GetSize();
+}
+
+void
+EndpointFlowCollector::NotifyUdpRx(EndpointFlowCollector* collector,
+                                   std::size_t station,
+                                   Ptr<const Packet> packet)
+{
+    SeqTsHeader seqTs;
+    packet->PeekHeader(seqTs);
+    collector->m_flows[station].Receive(packet->GetSize(), seqTs.GetTs());
+}
+
+void
+EndpointFlowCollector::NotifyTcpRx(EndpointFlowCollector* collector,
+                                   std::size_t station,
+                                   Ptr<const Packet> packet,
+                                   const Address& from,
+                                   const Address& to,
+                                   const SeqTsSizeHeader& header)
+{
+    collector->m_flows[station].Receive(header.GetSize(), header.GetTs());
+}
+
+void
+EndpointFlowCollector::FlowCounters::Receive(uint32_t bytes, Time sent)
+{
+    Time now = Simulator::Now();
+    if (rxPackets == 0)
+    {
+        firstRx = now;
+    }
+    lastRx = now;
+    rxPackets++;
+    rxBytes += bytes;
+    delaySum += now - sent;
+    delays.Add(now - sent);
+}
+
+void
+MacPhyCounters::Merge(const MacPhyCounters& other)
+{
+    txMpdus += other.txMpdus;
+    retries += other.retries;
+    ackedMpdus += other.ackedMpdus;
+    nackedMpdus += other.nackedMpdus;
+    dataPsdus += other.dataPsdus;
+    for (std::size_t i = 0; i < N_RU_TYPES; i++)
+    {
+        ruPsdus[i] += other.ruPsdus[i];
+    }
+    for (std::size_t i = 0; i < N_DROP_REASONS; i++)
+    {
+        droppedMpdus[i] += other.droppedMpdus[i];
+    }
+    for (std::size_t i = 0; i < N_RX_FAILURE_REASONS; i++)
+    {
+        rxDrops[i] += other.rxDrops[i];
+    }
+}
+
+std::string
+MacPhyCounters::Serialize() const
+{
+    std::ostringstream oss;
+    oss << txMpdus << "," << retries << "," << ackedMpdus << "," << nackedMpdus << ","
+        << dataPsdus;
+    for (uint64_t count : ruPsdus)
+    {
+        oss << "," << count;
+    }
+    for (uint64_t count : droppedMpdus)
+    {
+        oss << "," << count;
+    }
+    for (uint64_t count : rxDrops)
+    {
+        oss << "," << count;
+    }
+    return oss.str();
+}
+
+MacPhyCounters
+MacPhyCounters::Deserialize(const std::string& data)
+{
+    std::vector<uint64_t> values;
+    std::istringstream dataStream(data);
+    std::string value;
+    while (std::getline(dataStream, value, ','))
+    {
+        values.push_back(std::stoull(value));
+    }
+    NS_ABORT_MSG_IF(values.size() != 5 + N_RU_TYPES + N_DROP_REASONS + N_RX_FAILURE_REASONS,
+                    "Malformed MAC/PHY counters \"" << data << "\"");
+
+    MacPhyCounters counters;
+    auto it = values.begin();
+    counters.txMpdus = *it++;
+    counters.retries = *it++;
+    counters.ackedMpdus = *it++;
+    counters.nackedMpdus = *it++;
+    counters.dataPsdus = *it++;
+    for (auto& count : counters.ruPsdus)
+    {
+        count = *it++;
+    }
+    for (auto& count : counters.droppedMpdus)
+    {
+        count = *it++;
+    }
+    for (auto& count : counters.rxDrops)
+    {
+        count = *it++;
+    }
+    return counters;
+}
+
+MacPhyStatsCollector::MacPhyStatsCollector(const NetDeviceContainer& staAps,
+                                           const NetDeviceContainer& staDevices)
+    : m_staAps(staAps),
+      m_staDevices(staDevices),
+      m_downlink(staDevices.GetN()),
+      m_uplink(staDevices.GetN())
+{
+    for (uint32_t i = 0; i < staDevices.GetN(); i++)
+    {
+        m_stationOf[Mac48Address::ConvertFrom(staDevices.Get(i)->GetAddress())] = i;
+    }
+}
+
+void
+MacPhyStatsCollector::Start()
+{
+    for (uint32_t i = 0; i < m_staDevices.GetN(); i++)
+    {
+        Connect(m_staDevices.Get(i), i);
+        if (i == 0 || m_staAps.Get(i) != m_staAps.Get(i - 1))
+        {
+            Connect(m_staAps.Get(i), -1);
+        }
+    }
+}
+
+void
+MacPhyStatsCollector::Connect(Ptr<NetDevice> device, int32_t index)
+{
+    Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice>(device);
+    Ptr<WifiPhy> phy = wifiDevice->GetPhy();
+    Ptr<WifiMac> mac = wifiDevice->GetMac();
+    phy->TraceConnectWithoutContext("PhyTxPsduBegin",
+                                    MakeBoundCallback(&NotifyPsduTx, this, index));
+    phy->TraceConnectWithoutContext("PhyRxDrop", MakeBoundCallback(&NotifyRxDrop, this, index));
+    mac->TraceConnectWithoutContext("AckedMpdu", MakeBoundCallback(&NotifyAcked, this, index));
+    mac->TraceConnectWithoutContext("NAckedMpdu", MakeBoundCallback(&NotifyNAcked, this, index));
+    mac->TraceConnectWithoutContext("DroppedMpdu", MakeBoundCallback(&NotifyDropped, this, index));
+}
+
+const MacPhyCounters&
+MacPhyStatsCollector::GetDownlink(std::size_t station) const
+{
+    return m_downlink.at(station);
+}
+
+const MacPhyCounters&
+MacPhyStatsCollector::GetUplink(std::size_t station) const
+{
+    return m_uplink.at(station);
+}
+
+std::size_t
+MacPhyStatsCollector::GetNStations() const
+{
+    return m_downlink.size();
+}
+
+const MacPhyCounters&
+MacPhyStatsCollector::GetAps() const
+{
+    return m_aps;
+}
+
+MacPhyCounters*
+MacPhyStatsCollector::Find(int32_t device, Mac48Address receiver)
+{
+    if (device >= 0)
+    {
+        return &m_uplink[device];
+    }
+    auto it = m_stationOf.find(receiver);
+    return (it == m_stationOf.end() ? nullptr : &m_downlink[it->second]);
+}
+
+void
+MacPhyStatsCollector::NotifyPsduTx(MacPhyStatsCollector* collector,
+                                   int32_t device,
+                                   WifiConstPsduMap psduMap,
+                                   WifiTxVector txVector,
+                                   double txPowerW)
+{
+    for (const auto& [staId, psdu] : psduMap)
+    {
+        uint64_t nData = 0;
+        uint64_t nRetries = 0;
+        for (const auto& mpdu : *psdu)
+        {
+            if (mpdu->GetHeader().IsQosData())
+            {
+                nData++;
+                nRetries += (mpdu->GetHeader().IsRetry() ? 1 : 0);
+            }
+        }
+        MacPhyCounters* counters = collector->Find(device, psdu->GetAddr1());
+        if (nData == 0 || counters == nullptr)
+        {
+            continue;
+        }
+        counters->txMpdus += nData;
+        counters->retries += nRetries;
+        counters->dataPsdus++;
+        if (txVector.IsMu())
+        {
+            counters->ruPsdus[txVector.GetRu(staId).GetRuType()]++;
+        }
+    }
+}
+
+void
+MacPhyStatsCollector::NotifyRxDrop(MacPhyStatsCollector* collector,
+                                   int32_t device,
+                                   Ptr<const Packet> packet,
+                                   WifiPhyRxfailureReason reason)
+{
+    MacPhyCounters& counters = (device >= 0 ? collector->m_downlink[device] : collector->m_aps);
+    counters.rxDrops[std::min<std::size_t>(reason, MacPhyCounters::N_RX_FAILURE_REASONS - 1)]++;
+}
+
+void
+MacPhyStatsCollector::NotifyAcked(MacPhyStatsCollector* collector,
+                                  int32_t device,
+                                  Ptr<const WifiMpdu> mpdu)
+{
+    MacPhyCounters* counters = collector->Find(device, mpdu->GetHeader().GetAddr1());
+    if (counters && mpdu->GetHeader().IsQosData())
+    {
+        counters->ackedMpdus++;
+    }
+}
+
+void
+MacPhyStatsCollector::NotifyNAcked(MacPhyStatsCollector* collector,
+                                   int32_t device,
+                                   Ptr<const WifiMpdu> mpdu)
+{
+    MacPhyCounters* counters = collector->Find(device, mpdu->GetHeader().GetAddr1());
+    if (counters && mpdu->GetHeader().IsQosData())
+    {
+        counters->nackedMpdus++;
+    }
+}
+
+void
+MacPhyStatsCollector::NotifyDropped(MacPhyStatsCollector* collector,
+                                    int32_t device,
+                                    WifiMacDropReason reason,
+                                    Ptr<const WifiMpdu> mpdu)
+{
+    MacPhyCounters* counters = collector->Find(device, mpdu->GetHeader().GetAddr1());
+    if (counters && mpdu->GetHeader().IsQosData() && reason < MacPhyCounters::N_DROP_REASONS)
+    {
+        counters->droppedMpdus[reason]++;
+    }
+}
+
+/// Maximum duration of an HE PPDU (aPPDUMaxTime), in microseconds
+static const int64_t MAX_PPDU_DURATION_US = 5484;
+
+NS_OBJECT_ENSURE_REGISTERED(WeightedMultiUserScheduler);
+
+TypeId
+WeightedMultiUserScheduler::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::WeightedMultiUserScheduler")
+            .SetParent<MultiUserScheduler>()
+            .AddConstructor<WeightedMultiUserScheduler>()
+            .AddAttribute("Policy",
+                          "The weight of a station: the inverse of its average goodput (pf) or "
+                          "its backlog (maxweight)",
+                          EnumValue(PROPORTIONAL_FAIR),
+                          MakeEnumAccessor(&WeightedMultiUserScheduler::m_policy),
+                          MakeEnumChecker(PROPORTIONAL_FAIR, "pf", MAX_WEIGHT, "maxweight"))
+            .AddAttribute("NStations",
+                          "The maximum number of stations served by a DL MU PPDU",
+                          UintegerValue(4),
+                          MakeUintegerAccessor(&WeightedMultiUserScheduler::m_nStations),
+                          MakeUintegerChecker<uint8_t>(1, 74))
+            .AddAttribute("AveragingTime",
+                          "The time constant of the moving average of the goodput of a station",
+                          TimeValue(MilliSeconds(100)),
+                          MakeTimeAccessor(&WeightedMultiUserScheduler::m_averagingTime),
+                          MakeTimeChecker(NanoSeconds(1)));
+    return tid;
+}
+
+void
+WeightedMultiUserScheduler::DoInitialize()
+{
+    for (const auto& [ac, wifiAc] : wifiAcList)
+    {
+        m_apMac->GetTxopQueue(ac)->TraceConnectWithoutContext(
+            "Enqueue",
+            MakeCallback(&WeightedMultiUserScheduler::NotifyEnqueue, this));
+    }
+    m_apMac->TraceConnectWithoutContext(
+        "AckedMpdu",
+        MakeCallback(&WeightedMultiUserScheduler::NotifyAcked, this));
+    m_apMac->TraceConnectWithoutContext(
+        "NAckedMpdu",
+        MakeCallback(&WeightedMultiUserScheduler::NotifyNAcked, this));
+    m_apMac->TraceConnectWithoutContext(
+        "DroppedMpdu",
+        MakeCallback(&WeightedMultiUserScheduler::NotifyDropped, this));
+    MultiUserScheduler::DoInitialize();
+}
+
+WeightedMultiUserScheduler::Flow*
+WeightedMultiUserScheduler::Find(Ptr<const WifiMpdu> mpdu)
+{
+    const WifiMacHeader& header = mpdu->GetHeader();
+    if (!header.IsQosData() || header.GetAddr1().IsGroup())
+    {
+        return nullptr;
+    }
+    return &m_flows[header.GetAddr1()];
+}
+
+void
+WeightedMultiUserScheduler::NotifyEnqueue(Ptr<const WifiMpdu> mpdu)
+{
+    if (Flow* flow = Find(mpdu))
+    {
+        flow->backlog += mpdu->GetPacketSize();
+    }
+}
+
+void
+WeightedMultiUserScheduler::NotifyAcked(Ptr<const WifiMpdu> mpdu)
+{
+    if (Flow* flow = Find(mpdu))
+    {
+        flow->backlog -= mpdu->GetPacketSize();
+        flow->acked++;
+        flow->ackedBits += mpdu->GetPacketSize() * 8;
+    }
+}
+
+void
+WeightedMultiUserScheduler::NotifyNAcked(Ptr<const WifiMpdu> mpdu)
+{
+    if (Flow* flow = Find(mpdu))
+    {
+        flow->nacked++;
+    }
+}
+
+void
+WeightedMultiUserScheduler::NotifyDropped(WifiMacDropReason reason, Ptr<const WifiMpdu> mpdu)
+{
+    // the MPDUs that could not be enqueued were not counted in the backlog
+    if (reason == WIFI_MAC_DROP_FAILED_ENQUEUE)
+    {
+        return;
+    }
+    if (Flow* flow = Find(mpdu))
+    {
+        flow->backlog -= mpdu->GetPacketSize();
+    }
+}
+
+double
+WeightedMultiUserScheduler::GetBytes(const Candidate& candidate, const HeRu::RuSpec& ru) const
+{
+    uint64_t rate = candidate.mode.GetDataRate(HeRu::GetBandwidth(ru.GetRuType()),
+                                               m_txParams.m_txVector.GetGuardInterval(),
+                                               candidate.nss);
+    return std::min(candidate.maxBytes,
+                    rate * candidate.success * MAX_PPDU_DURATION_US * 1e-6 / 8);
+}
+
+std::vector<HeRu::RuSpec>
+WeightedMultiUserScheduler::AllocateRus(const std::vector<Candidate>& candidates) const
+{
+    uint16_t width = m_allowedWidth;
+    std::vector<HeRu::RuSpec> rus{HeRu::GetRusOfType(width, HeRu::GetRuType(width)).front()};
+    auto getValue = [&](std::size_t i, const HeRu::RuSpec& ru) {
+        return candidates[i].weight * GetBytes(candidates[i], ru);
+    };
+    double value = getValue(0, rus[0]);
+
+    while (rus.size() < std::min<std::size_t>(candidates.size(), m_nStations))
+    {
+        // give the next candidate half of the RU whose split most increases the value
+        std::size_t next = rus.size();
+        double bestValue = value;
+        std::size_t bestRu = next;
+        std::vector<HeRu::RuSpec> bestHalves;
+        for (std::size_t i = 0; i < rus.size(); i++)
+        {
+            if (rus[i].GetRuType() == HeRu::RU_26_TONE)
+            {
+                continue;
+            }
+            auto halfType = static_cast<HeRu::RuType>(rus[i].GetRuType() - 1);
+            std::vector<HeRu::RuSpec> halves;
+            for (const auto& ru : HeRu::GetRusOfType(width, halfType))
+            {
+                if (HeRu::DoesOverlap(width, ru, {rus[i]}))
+                {
+                    halves.push_back(ru);
+                }
+            }
+            if (halves.size() != 2)
+            {
+                continue;
+            }
+            double split = value - getValue(i, rus[i]) + getValue(i, halves[0]) +
+                           getValue(next, halves[1]);
+            if (split > bestValue)
+            {
+                bestValue = split;
+                bestRu = i;
+                bestHalves = halves;
+            }
+        }
+        if (bestRu == next)
+        {
+            break;
+        }
+        rus[bestRu] = bestHalves[0];
+        rus.push_back(bestHalves[1]);
+        value = bestValue;
+    }
+    return rus;
+}
+
+MultiUserScheduler::TxFormat
+WeightedMultiUserScheduler::SelectTxFormat()
+{
+    Ptr<const WifiMpdu> mpdu = m_edca->PeekNextMpdu(SINGLE_LINK_OP_ID);
+    if (mpdu && !GetWifiRemoteStationManager()->GetHeSupported(mpdu->GetHeader().GetAddr1()))
+    {
+        return SU_TX;
+    }
+
+    Ptr<HeConfiguration> heConfiguration = m_apMac->GetHeConfiguration();
+    m_txParams.Clear();
+    m_txParams.m_txVector.SetPreambleType(WIFI_PREAMBLE_HE_MU);
+    m_txParams.m_txVector.SetChannelWidth(m_allowedWidth);
+    m_txParams.m_txVector.SetGuardInterval(heConfiguration->GetGuardInterval().GetNanoSeconds());
+    m_txParams.m_txVector.SetBssColor(heConfiguration->GetBssColor());
+
+    AcIndex ac = m_edca->GetAccessCategory();
+    std::vector<Candidate> candidates;
+    for (const auto& [aid, address] : m_apMac->GetStaList())
+    {
+        if (!GetWifiRemoteStationManager()->GetHeSupported(address))
+        {
+            continue;
+        }
+        for (uint8_t tid : {wifiAcList.at(ac).GetHighTid(), wifiAcList.at(ac).GetLowTid()})
+        {
+            Ptr<WifiMpdu> peeked = m_edca->PeekNextMpdu(SINGLE_LINK_OP_ID, tid, address);
+            if (!peeked || !m_heFem->GetBaAgreementEstablished(address, tid))
+            {
+                continue;
+            }
+
+            // the goodput over the time elapsed since the last update enters the average with
+            // the weight that this time has in an exponential window
+            Flow& flow = m_flows[address];
+            Time elapsed = Simulator::Now() - flow.lastUpdate;
+            if (elapsed.IsStrictlyPositive())
+            {
+                double alpha = 1 - std::exp(-elapsed.GetSeconds() / m_averagingTime.GetSeconds());
+                flow.goodput += alpha * (flow.ackedBits / elapsed.GetSeconds() - flow.goodput);
+                flow.ackedBits = 0;
+                flow.lastUpdate = Simulator::Now();
+            }
+
+            WifiTxVector suTxVector =
+                GetWifiRemoteStationManager()->GetDataTxVector(peeked->GetHeader(),
+                                                               m_allowedWidth);
+            Candidate candidate;
+            candidate.aid = aid;
+            candidate.address = address;
+            candidate.mpdu = peeked;
+            candidate.mode = suTxVector.GetMode();
+            candidate.nss = suTxVector.GetNss();
+            uint64_t nTx = flow.acked + flow.nacked;
+            candidate.success = (nTx > 0 ? static_cast<double>(flow.acked) / nTx : 1);
+            // a station with a queued MPDU has at least this MPDU in its backlog, and a PSDU
+            // holds at most as many MPDUs as the block ack window
+            double backlog = std::max<double>(flow.backlog, peeked->GetPacketSize());
+            candidate.maxBytes = std::min<double>(
+                backlog,
+                m_edca->GetBaBufferSize(address, tid) * peeked->GetSize());
+            candidate.weight =
+                (m_policy == MAX_WEIGHT ? backlog : 1 / std::max(flow.goodput, 1e3));
+            uint16_t guardInterval = m_txParams.m_txVector.GetGuardInterval();
+            candidate.priority =
+                candidate.weight * candidate.success *
+                candidate.mode.GetDataRate(m_allowedWidth, guardInterval, candidate.nss);
+            candidates.push_back(candidate);
+            break;
+        }
+    }
+
+    // candidates in decreasing order of weight times achievable rate
+    std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a.priority > b.priority;
+    });
+
+    // drop the candidates whose first MPDU does not meet the time constraints, and allocate again
+    Time availableTime = (m_initialFrame ? Time::Min() : m_availableTime);
+    WifiTxVector muTxVector = m_txParams.m_txVector;
+    while (!candidates.empty())
+    {
+        m_rus = AllocateRus(candidates);
+        m_served.assign(candidates.begin(), candidates.begin() + m_rus.size());
+        m_txParams.Clear();
+        m_txParams.m_txVector = muTxVector;
+        for (std::size_t i = 0; i < m_served.size(); i++)
+        {
+            m_txParams.m_txVector.SetHeMuUserInfo(
+                m_served[i].aid,
+                {m_rus[i], m_served[i].mode, m_served[i].nss});
+        }
+        auto failed = std::find_if(m_served.begin(), m_served.end(), [&](const auto& served) {
+            return !m_heFem->TryAddMpdu(served.mpdu, m_txParams, availableTime);
+        });
+        if (failed == m_served.end())
+        {
+            return DL_MU_TX;
+        }
+        NS_LOG_DEBUG("The first MPDU for " << failed->address
+                                           << " violates the time constraints");
+        candidates.erase(candidates.begin() + (failed - m_served.begin()));
+    }
+    m_served.clear();
+    return SU_TX;
+}
+
+MultiUserScheduler::DlMuInfo
+WeightedMultiUserScheduler::ComputeDlMuInfo()
+{
+    DlMuInfo dlMuInfo;
+    if (m_served.empty())
+    {
+        return dlMuInfo;
+    }
+
+    // compute the TX parameters again with the final TXVECTOR
+    dlMuInfo.txParams.m_txVector = m_txParams.m_txVector;
+    m_txParams.Clear();
+    Time availableTime = (m_initialFrame ? Time::Min() : m_availableTime);
+    for (const auto& served : m_served)
+    {
+        bool added [[maybe_unused]] =
+            m_heFem->TryAddMpdu(served.mpdu, dlMuInfo.txParams, availableTime);
+        NS_ASSERT_MSG(added, "The first MPDU of a served station no longer fits in the PPDU");
+    }
+
+    // complete the PSDUs with A-MSDU and A-MPDU aggregation, as RrMultiUserScheduler does
+    for (const auto& served : m_served)
+    {
+        Ptr<WifiMpdu> mpdu = served.mpdu;
+        uint8_t tid = mpdu->GetHeader().GetQosTid();
+        if (!mpdu->GetHeader().IsRetry())
+        {
+            mpdu = m_heFem->GetMsduAggregator()->GetNextAmsdu(mpdu,
+                                                              dlMuInfo.txParams,
+                                                              m_availableTime);
+            if (!mpdu)
+            {
+                // A-MSDU aggregation failed or is disabled
+                mpdu = served.mpdu;
+            }
+            m_apMac->GetQosTxop(QosUtilsMapTidToAc(tid))->AssignSequenceNumber(mpdu);
+        }
+        std::vector<Ptr<WifiMpdu>> mpduList =
+            m_heFem->GetMpduAggregator()->GetNextAmpdu(mpdu, dlMuInfo.txParams, m_availableTime);
+        if (mpduList.size() > 1)
+        {
+            dlMuInfo.psduMap[served.aid] = Create<WifiPsdu>(std::move(mpduList));
+        }
+        else
+        {
+            dlMuInfo.psduMap[served.aid] = Create<WifiPsdu>(mpdu, true);
+        }
+    }
+    return dlMuInfo;
+}
+
+MultiUserScheduler::UlMuInfo
+WeightedMultiUserScheduler::ComputeUlMuInfo()
+{
+    NS_ABORT_MSG("WeightedMultiUserScheduler does not schedule UL MU transmissions");
+    return UlMuInfo();
+}
+
+/// Size of the buffer of a pcap output that triggers a write
+static const std::size_t PCAP_BUFFER_SIZE = 1 << 20;
+
+PcapCapture::PcapCapture(const std::string& prefix,
+                         uint32_t snapLen,
+                         uint64_t maxFileSize,
+                         Time window,
+                         uint32_t maxFiles)
+    : m_prefix(prefix),
+      m_snapLen(snapLen),
+      m_maxFileSize(maxFileSize),
+      m_window(window),
+      m_maxFiles(maxFiles)
+{
+    if (m_window.IsStrictlyPositive())
+    {
+        Simulator::Schedule(m_window, &PcapCapture::StartWindow, this);
+    }
+}
+
+PcapCapture::~PcapCapture()
+{
+    for (auto& output : m_outputs)
+    {
+        if (output.fd >= 0)
+        {
+            Flush(output);
+            close(output.fd);
+        }
+    }
+}
+
+void
+PcapCapture::Add(Ptr<NetDevice> device, const std::string& name)
+{
+    Output output;
+    output.name = name;
+    Rotate(output);
+    m_outputs.push_back(output);
+
+    Ptr<WifiPhy> phy = DynamicCast<WifiNetDevice>(device)->GetPhy();
+    phy->TraceConnectWithoutContext("MonitorSnifferTx",
+                                    MakeBoundCallback(&NotifyTx, this, m_outputs.size() - 1));
+    phy->TraceConnectWithoutContext("MonitorSnifferRx",
+                                    MakeBoundCallback(&NotifyRx, this, m_outputs.size() - 1));
+}
+
+void
+PcapCapture::NotifyTx(PcapCapture* capture,
+                      std::size_t output,
+                      Ptr<const Packet> packet,
+                      uint16_t channelFreqMhz,
+                      WifiTxVector txVector,
+                      MpduInfo aMpdu,
+                      uint16_t staId)
+{
+    capture->Write(output, packet, GetRadiotapHeader(channelFreqMhz, txVector, aMpdu, staId));
+}
+
+void
+PcapCapture::NotifyRx(PcapCapture* capture,
+                      std::size_t output,
+                      Ptr<const Packet> packet,
+                      uint16_t channelFreqMhz,
+                      WifiTxVector txVector,
+                      MpduInfo aMpdu,
+                      SignalNoiseDbm signalNoise,
+                      uint16_t staId)
+{
+    RadiotapHeader header = GetRadiotapHeader(channelFreqMhz, txVector, aMpdu, staId);
+    header.SetAntennaSignalPower(signalNoise.signal);
+    header.SetAntennaNoisePower(signalNoise.noise);
+    capture->Write(output, packet, header);
+}
+
+RadiotapHeader
+PcapCapture::GetRadiotapHeader(uint16_t channelFreqMhz,
+                               const WifiTxVector& txVector,
+                               MpduInfo aMpdu,
+                               uint16_t staId)
+{
+    // the scenarios only send non-HT (control and management) and HE PPDUs
+    WifiModulationClass modClass = txVector.GetMode(staId).GetModulationClass();
+    bool dsss = (modClass == WIFI_MOD_CLASS_DSSS || modClass == WIFI_MOD_CLASS_HR_DSSS);
+    RadiotapHeader header;
+    header.SetTsft(Simulator::Now().GetMicroSeconds());
+    header.SetFrameFlags(RadiotapHeader::FRAME_FLAG_FCS_INCLUDED);
+    header.SetChannelFrequencyAndFlags(
+        channelFreqMhz,
+        (dsss ? RadiotapHeader::CHANNEL_FLAG_CCK : RadiotapHeader::CHANNEL_FLAG_OFDM) |
+            (channelFreqMhz < 2500 ? RadiotapHeader::CHANNEL_FLAG_SPECTRUM_2GHZ
+                                   : RadiotapHeader::CHANNEL_FLAG_SPECTRUM_5GHZ));
+    if (modClass != WIFI_MOD_CLASS_HE)
+    {
+        // in units of 500 kbit/s
+        header.SetRate(txVector.GetMode(staId).GetDataRate(txVector, staId) / 500000);
+    }
+    if (aMpdu.type != NORMAL_MPDU)
+    {
+        header.SetAmpduStatus(aMpdu.mpduRefNumber,
+                              RadiotapHeader::A_MPDU_STATUS_LAST_KNOWN |
+                                  (aMpdu.type == LAST_MPDU_IN_AGGREGATE
+                                       ? RadiotapHeader::A_MPDU_STATUS_LAST
+                                       : 0),
+                              1);
+    }
+    if (modClass == WIFI_MOD_CLASS_HE)
+    {
+        WifiPreamble preamble = txVector.GetPreambleType();
+        bool mu = (preamble == WIFI_PREAMBLE_HE_MU || preamble == WIFI_PREAMBLE_HE_TB);
+        uint16_t data1 = RadiotapHeader::HE_DATA1_BSS_COLOR_KNOWN |
+                         RadiotapHeader::HE_DATA1_DATA_MCS_KNOWN |
+                         RadiotapHeader::HE_DATA1_BW_RU_ALLOC_KNOWN;
+        if (preamble == WIFI_PREAMBLE_HE_ER_SU)
+        {
+            data1 |= RadiotapHeader::HE_DATA1_FORMAT_EXT_SU;
+        }
+        else if (preamble == WIFI_PREAMBLE_HE_MU)
+        {
+            data1 |= RadiotapHeader::HE_DATA1_FORMAT_MU;
+        }
+        else if (preamble == WIFI_PREAMBLE_HE_TB)
+        {
+            data1 |= RadiotapHeader::HE_DATA1_FORMAT_TRIG;
+        }
+
+        uint16_t data2 = RadiotapHeader::HE_DATA2_GI_KNOWN;
+        uint16_t data5 = 0;
+        if (mu)
+        {
+            // the RU indices start at 1 in ns-3 and at 0 in radiotap
+            HeRu::RuSpec ru = txVector.GetRu(staId);
+            data2 |= RadiotapHeader::HE_DATA2_RU_OFFSET_KNOWN |
+                     (((ru.GetIndex() - 1) << 8) & 0x3f00) | (ru.GetPrimary80MHz() ? 0 : 0x8000);
+            // the RU types and their radiotap codes are in the same order, from 26 tones up
+            data5 |= RadiotapHeader::HE_DATA5_DATA_BW_RU_ALLOC_26T + ru.GetRuType();
+        }
+        else if (txVector.GetChannelWidth() == 40)
+        {
+            data5 |= RadiotapHeader::HE_DATA5_DATA_BW_RU_ALLOC_40MHZ;
+        }
+        else if (txVector.GetChannelWidth() == 80)
+        {
+            data5 |= RadiotapHeader::HE_DATA5_DATA_BW_RU_ALLOC_80MHZ;
+        }
+        else if (txVector.GetChannelWidth() == 160)
+        {
+            data5 |= RadiotapHeader::HE_DATA5_DATA_BW_RU_ALLOC_160MHZ;
+        }
+        if (txVector.GetGuardInterval() == 1600)
+        {
+            data5 |= RadiotapHeader::HE_DATA5_GI_1_6;
+        }
+        else if (txVector.GetGuardInterval() == 3200)
+        {
+            data5 |= RadiotapHeader::HE_DATA5_GI_3_2;
+        }
+
+        uint16_t data3 = (txVector.GetBssColor() & 0x003f) |
+                         ((txVector.GetMode(staId).GetMcsValue() << 8) & 0x0f00);
+        uint16_t data4 = (preamble == WIFI_PREAMBLE_HE_MU ? (staId << 4) & 0x7ff0 : 0);
+        header.SetHeFields(data1, data2, data3, data4, data5, 0);
+    }
+    return header;
+}
+
+void
+PcapCapture::Write(std::size_t index, Ptr<const Packet> packet, const RadiotapHeader& header)
+{
+    Output& output = m_outputs[index];
+    Time now = Simulator::Now();
+    Ptr<Packet> frame = packet->Copy();
+    frame->AddHeader(header);
+    uint32_t size = frame->GetSize();
+    uint32_t capturedSize = (m_snapLen > 0 ? std::min(size, m_snapLen) : size);
+
+    if (m_maxFileSize > 0 && output.size > 24 && output.size + 16 + capturedSize > m_maxFileSize)
+    {
+        Rotate(output);
+    }
+
+    // record header: seconds, microseconds, captured length and original length
+    uint32_t record[4] = {static_cast<uint32_t>(now.GetMicroSeconds() / 1000000),
+                          static_cast<uint32_t>(now.GetMicroSeconds() % 1000000),
+                          capturedSize,
+                          size};
+    output.buffer.append(reinterpret_cast<const char*>(record), sizeof(record));
+    m_frame.resize(capturedSize);
+    frame->CopyData(m_frame.data(), capturedSize);
+    output.buffer.append(reinterpret_cast<const char*>(m_frame.data()), capturedSize);
+    output.size += sizeof(record) + capturedSize;
+    if (output.buffer.size() >= PCAP_BUFFER_SIZE)
+    {
+        Flush(output);
+    }
+}
+
+void
+PcapCapture::Rotate(Output& output)
+{
+    if (output.fd >= 0)
+    {
+        Flush(output);
+        close(output.fd);
+    }
+    std::string path =
+        m_prefix + "-" + output.name + "-" + std::to_string(output.nFiles++) + ".pcap";
+    output.fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    NS_ABORT_MSG_IF(output.fd < 0, "Cannot open " << path << ": " << std::strerror(errno));
+    output.paths.push_back(path);
+    if (m_maxFiles > 0 && output.paths.size() > m_maxFiles)
+    {
+        unlink(output.paths.front().c_str());
+        output.paths.pop_front();
+    }
+
+    // global header: magic number, version 2.4, time zone, accuracy, snapshot length, link type
+    uint32_t magic = 0xa1b2c3d4;
+    uint16_t version[2] = {2, 4};
+    uint32_t fields[4] = {0,
+                          0,
+                          (m_snapLen > 0 ? m_snapLen : 65535),
+                          WifiPhyHelper::DLT_IEEE802_11_RADIO};
+    output.buffer.append(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    output.buffer.append(reinterpret_cast<const char*>(version), sizeof(version));
+    output.buffer.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+    output.size = output.buffer.size();
+}
+
+void
+PcapCapture::StartWindow()
+{
+    for (auto& output : m_outputs)
+    {
+        Rotate(output);
+    }
+    Simulator::Schedule(m_window, &PcapCapture::StartWindow, this);
+}
+
+void
+PcapCapture::Flush(Output& output)
+{
+    NS_ABORT_MSG_IF(!WriteAll(output.fd, output.buffer),
+                    "Cannot write the capture of " << output.name << ": " << std::strerror(errno));
+    output.buffer.clear();
+}
+
+void
+DelayHistogram::Add(Time delay)
+{
+    if (m_counts.empty())
+    {
+        m_counts.resize(N_BUCKETS);
+    }
+    uint64_t value = std::max<int64_t>(delay.GetNanoSeconds(), 0);
+    m_counts[GetIndex(value)]++;
+    m_count++;
+    m_max = std::max(m_max, value);
+}
+
+void
+DelayHistogram::Merge(const DelayHistogram& other)
+{
+    if (other.m_counts.empty())
+    {
+        return;
+    }
+    if (m_counts.empty())
+    {
+        m_counts.resize(N_BUCKETS);
+    }
+    for (std::size_t i = 0; i < N_BUCKETS; i++)
+    {
+        m_counts[i] += other.m_counts[i];
+    }
+    m_count += other.m_count;
+    m_max = std::max(m_max, other.m_max);
+}
+
+uint64_t
+DelayHistogram::GetCount() const
+{
+    return m_count;
+}
+
+Time
+DelayHistogram::GetPercentile(double percentile) const
+{
+    if (m_count == 0)
+    {
+        return Seconds(0);
+    }
+    auto rank = static_cast<uint64_t>(std::ceil(percentile / 100 * m_count));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < N_BUCKETS; i++)
+    {
+        seen += m_counts[i];
+        if (seen >= rank)
+        {
+            return NanoSeconds(std::min(GetMidpoint(i), m_max));
+        }
+    }
+    return NanoSeconds(m_max);
+}
+
+Time
+DelayHistogram::GetMax() const
+{
+    return NanoSeconds(m_max);
+}
+
+std::string
+DelayHistogram::Serialize() const
+{
+    std::ostringstream oss;
+    oss << m_max;
+    for (std::size_t i = 0; i < m_counts.size(); i++)
+    {
+        if (m_counts[i] > 0)
+        {
+            oss << "," << i << ":" << m_counts[i];
+        }
+    }
+    return oss.str();
+}
+
+DelayHistogram
+DelayHistogram::Deserialize(const std::string& data)
+{
+    DelayHistogram histogram;
+    std::istringstream dataStream(data);
+    std::string item;
+    std::getline(dataStream, item, ',');
+    histogram.m_max = std::stoull(item);
+    while (std::getline(dataStream, item, ','))
+    {
+        auto colon = item.find(':');
+        NS_ABORT_MSG_IF(colon == std::string::npos, "Malformed histogram bucket \"" << item << "\"");
+        std::size_t index = std::stoul(item.substr(0, colon));
+        NS_ABORT_MSG_IF(index >= N_BUCKETS, "Invalid histogram bucket " << index);
+        if (histogram.m_counts.empty())
+        {
+            histogram.m_counts.resize(N_BUCKETS);
+        }
+        histogram.m_counts[index] = std::stoull(item.substr(colon + 1));
+        histogram.m_count += histogram.m_counts[index];
+    }
+    return histogram;
+}
+
+std::size_t
+DelayHistogram::GetIndex(uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+    {
+        return value;
+    }
+    // keep the SUB_BUCKET_BITS most significant bits of the value, the first of which is 1
+    unsigned shift = 64 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+    return SUB_BUCKETS + (shift - 1) * (SUB_BUCKETS / 2) + ((value >> shift) - SUB_BUCKETS / 2);
+}
+
+uint64_t
+DelayHistogram::GetMidpoint(std::size_t index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+    // the bucket holds the 2^shift values from mantissa * 2^shift
+    unsigned shift = (index - SUB_BUCKETS) / (SUB_BUCKETS / 2) + 1;
+    uint64_t mantissa = (index - SUB_BUCKETS) % (SUB_BUCKETS / 2) + SUB_BUCKETS / 2;
+    return (mantissa << shift) + (uint64_t{1} << (shift - 1));
+}
+
+/**
+ * Assign a channel to every BSS of a scenario, taking the channels of the channel plan in turn.
+ *
+ * \param config the scenario
+ * \return the channel number of every BSS, 0 standing for the default channel of the band
+ */
+std::vector<uint16_t>
+GetChannelPlan(const ScenarioConfig& config)
+{
+    std::vector<uint16_t> plan;
+    std::istringstream planStream(config.channelPlan);
+    std::string channel;
+    while (std::getline(planStream, channel, ','))
+    {
+        NS_ABORT_MSG_IF(channel.empty() || channel.size() > 3 ||
+                            channel.find_first_not_of("0123456789") != std::string::npos,
+                        "Invalid channel \"" << channel << "\" in channel plan");
+        plan.push_back(std::stoi(channel));
+    }
+    if (plan.empty())
+    {
+        plan.push_back(0);
+    }
+
+    std::vector<uint16_t> channels;
+    for (uint32_t b = 0; b < config.nBss; b++)
+    {
+        channels.push_back(plan[b % plan.size()]);
+    }
+    return channels;
+}
+
+/**
+ * Parse the selection of the devices to capture.
+ *
+ * \param devices a ',' separated list of ap (the APs), covert (the covert station), stations,
+ *        all, or indices of stations
+ * \return the items of the list
+ */
+std::set<std::string>
+ParsePcapDevices(const std::string& devices)
+{
+    std::set<std::string> selection;
+    std::istringstream devicesStream(devices);
+    std::string item;
+    while (std::getline(devicesStream, item, ','))
+    {
+        NS_ABORT_MSG_IF(item != "ap" && item != "covert" && item != "stations" && item != "all" &&
+                            (item.empty() ||
+                             item.find_first_not_of("0123456789") != std::string::npos),
+                        "Invalid pcap device \"" << item
+                                                 << "\" (must be ap, covert, stations, all or a "
+                                                    "station index)");
+        selection.insert(item);
+    }
+    return selection;
+}
+
+/**
+ * Split the BSSs of a scenario into groups that can be simulated independently.
+ *
+ * The channel number of a BSS is the number of its operating channel, whose center frequency is
+ * 5 MHz times the number above the start of the band, and all the BSSs have the same channel
+ * width. Two BSSs interfere if their channels overlap, i.e. if their center frequencies are less
+ * than a channel width apart; the default channel is assumed to overlap with every channel. The
+ * partitions are the connected components of the interference relation: the BSSs sharing a
+ * channel, directly or through other BSSs, are simulated together, whatever their distance.
+ *
+ * \param config the scenario
+ * \return one scenario per partition, simulating the BSSs of the partition, or the scenario itself
+ *         if all the BSSs belong to a single partition
+ */
+std::vector<ScenarioConfig>
+PartitionBss(const ScenarioConfig& config)
+{
+    std::vector<uint16_t> channels = GetChannelPlan(config);
+    auto overlap = [&](uint32_t a, uint32_t b) {
+        return channels[a] == 0 || channels[b] == 0 ||
+               5 * std::abs(channels[a] - channels[b]) < config.channelWidth;
+    };
+
+    std::vector<bool> assigned(config.nBss, false);
+    std::vector<ScenarioConfig> partitions;
+    for (uint32_t first = 0; first < config.nBss; first++)
+    {
+        if (assigned[first])
+        {
+            continue;
+        }
+        ScenarioConfig partition = config;
+        partition.bss = {first};
+        assigned[first] = true;
+        // breadth-first search of the BSSs reachable from the first one
+        for (std::size_t k = 0; k < partition.bss.size(); k++)
+        {
+            for (uint32_t b = first + 1; b < config.nBss; b++)
+            {
+                if (!assigned[b] && overlap(partition.bss[k], b))
+                {
+                    partition.bss.push_back(b);
+                    assigned[b] = true;
+                }
+            }
+        }
+        std::sort(partition.bss.begin(), partition.bss.end());
+        partitions.push_back(partition);
+    }
+
+    if (partitions.size() == 1)
+    {
+        return {config};
+    }
+    for (auto& partition : partitions)
+    {
+        // each partition writes its own samples file
+        partition.samplesFile =
+            AddFileSuffix(config.samplesFile, "-bss" + std::to_string(partition.bss.front()));
+    }
+    return partitions;
+}
+
+/**
+ * Merge the results of the partitions of a scenario into the result of the whole scenario. The
+ * goodputs and the counters are added, and the stations and the flows are numbered over the
+ * whole scenario. The setup and run times are the sums of those of the partitions, i.e. the
+ * processing time rather than the elapsed time, and the memory is the largest of the partitions.
+ *
+ * \param partitions the partitions, as returned by PartitionBss()
+ * \param results the result of every partition
+ * \return the result of the scenario
+ */
+ScenarioResult
+MergePartitions(const std::vector<ScenarioConfig>& partitions,
+                const std::vector<ScenarioResult>& results)
+{
+    if (results.size() == 1)
+    {
+        return results.front();
+    }
+
+    const std::size_t nStations = partitions.front().nStations;
+    ScenarioResult merged;
+    merged.stationRxBytes.resize(partitions.front().nBss * nStations, 0);
+    merged.stationDlMacPhy.resize(partitions.front().nBss * nStations);
+    merged.stationUlMacPhy.resize(partitions.front().nBss * nStations);
+    double delaySum = 0;
+    for (std::size_t p = 0; p < partitions.size(); p++)
+    {
+        const ScenarioResult& result = results[p];
+        // index among all the stations of the scenario of a station of the partition
+        auto getStation = [&](std::size_t local) {
+            return partitions[p].bss[local / nStations] * nStations + local % nStations;
+        };
+
+        merged.rxBytes += result.rxBytes;
+        merged.throughput += result.throughput;
+        merged.duration = std::max(merged.duration, result.duration);
+        merged.txPackets += result.txPackets;
+        merged.rxPackets += result.rxPackets;
+        delaySum += result.delay * result.rxPackets;
+        merged.delays.Merge(result.delays);
+        uint32_t flowIdOffset = merged.flows.size();
+        for (FlowResult flow : result.flows)
+        {
+            flow.flowId += flowIdOffset;
+            if (flow.station >= 0)
+            {
+                flow.station = getStation(flow.station);
+            }
+            merged.flows.push_back(flow);
+        }
+        for (std::size_t i = 0; i < result.stationRxBytes.size(); i++)
+        {
+            merged.stationRxBytes[getStation(i)] = result.stationRxBytes[i];
+        }
+        for (std::size_t i = 0; i < result.stationDlMacPhy.size(); i++)
+        {
+            merged.stationDlMacPhy[getStation(i)] = result.stationDlMacPhy[i];
+            merged.stationUlMacPhy[getStation(i)] = result.stationUlMacPhy[i];
+        }
+        merged.apMacPhy.Merge(result.apMacPhy);
+        merged.setupTime += result.setupTime;
+        merged.runTime += result.runTime;
+        merged.events += result.events;
+        merged.peakRss = std::max(merged.peakRss, result.peakRss);
+    }
+    merged.delay = (merged.rxPackets > 0 ? delaySum / merged.rxPackets : 0);
+    return merged;
+}
+
+/**
+ * Expand a sweep grid specification into the list of scenarios to simulate.
+ *
+ * The specification is a ';' separated list of "dimension=values" items, where the dimension is
+ * one of mcs, width, gi or seed and the values are a ',' separated list of integers or
+ * "first-last" ranges. The points are enumerated with the seed varying fastest.
+ *
+ * \param grid the grid specification
+ * \param base the scenario providing every parameter that is not swept
+ * \return the scenarios of the grid
+ */
+std::vector<ScenarioConfig>
+ParseGrid(const std::string& grid, const ScenarioConfig& base)
+{
+    std::map<std::string, std::vector<int>> dimensions{{"mcs", {base.mcs}},
+                                                       {"width", {base.channelWidth}},
+                                                       {"gi", {base.guardInterval}},
+                                                       {"seed", {static_cast<int>(base.seed)}}};
+
+    std::istringstream gridStream(grid);
+    std::string item;
+    while (std::getline(gridStream, item, ';'))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        auto pos = item.find('=');
+        NS_ABORT_MSG_IF(pos == std::string::npos, "Invalid grid item \"" << item << "\"");
+        std::string name = item.substr(0, pos);
+        NS_ABORT_MSG_IF(dimensions.find(name) == dimensions.end(),
+                        "Unknown grid dimension \"" << name << "\" (must be mcs, width, gi or seed)");
+
+        std::vector<int> values;
+        std::istringstream valueStream(item.substr(pos + 1));
+        std::string value;
+        while (std::getline(valueStream, value, ','))
+        {
+            auto dash = value.find('-', 1);
+            int first = std::stoi(value.substr(0, dash));
+            int last = (dash == std::string::npos ? first : std::stoi(value.substr(dash + 1)));
+            NS_ABORT_MSG_IF(last < first, "Invalid range \"" << value << "\" in grid");
+            for (int v = first; v <= last; v++)
+            {
+                values.push_back(v);
+            }
+        }
+        NS_ABORT_MSG_IF(values.empty(), "No values given for grid dimension \"" << name << "\"");
+        dimensions[name] = values;
+    }
+
+    std::vector<ScenarioConfig> points;
+    for (int mcs : dimensions["mcs"])
+    {
+        for (int width : dimensions["width"])
+        {
+            for (int gi : dimensions["gi"])
+            {
+                for (int seed : dimensions["seed"])
+                {
+                    ScenarioConfig point = base;
+                    point.mcs = mcs;
+                    point.channelWidth = width;
+                    point.guardInterval = gi;
+                    point.seed = seed;
+                    points.push_back(point);
+                }
+            }
+        }
+    }
+    return points;
+}
+
+/**
+ * Run every scenario in a separate child process, keeping at most nWorkers children alive at
+ * any time. Each child sends its serialized result back through a pipe. The partitions of a
+ * multi-BSS scenario (see PartitionBss()) are run by separate children, and their results are
+ * merged once they have all completed.
+ *
+ * \param configs the scenarios to simulate
+ * \param nWorkers the maximum number of concurrent worker processes
+ * \param onResult if not null, called with the index and the result of every scenario as soon as
+ *        it completes
+ * \return the results, in the same order as the scenarios
+ */
+std::vector<ScenarioResult>
+RunScenarios(const std::vector<ScenarioConfig>& configs,
+             uint32_t nWorkers,
+             const std::function<void(std::size_t, const ScenarioResult&)>& onResult,
+             const ResultCache* cache)
+{
+    struct Worker
+    {
+        pid_t pid;
+        int fd;
+        std::size_t index;
+        std::string data;
+    };
+
+    std::vector<ScenarioResult> results(configs.size());
+    std::vector<ScenarioConfig> jobs;
+    std::vector<std::size_t> jobScenario;                   // scenario of every job
+    std::vector<std::vector<std::size_t>> scenarioJobs(configs.size());
+    std::vector<std::size_t> nPending(configs.size(), 0);  // jobs of every scenario not completed
+    std::size_t nCached = 0;
+    for (std::size_t i = 0; i < configs.size(); i++)
+    {
+        if (cache && cache->Lookup(configs[i], results[i]))
+        {
+            nCached++;
+            if (onResult)
+            {
+                onResult(i, results[i]);
+            }
+            continue;
+        }
+        for (const auto& partition : PartitionBss(configs[i]))
+        {
+            scenarioJobs[i].push_back(jobs.size());
+            jobScenario.push_back(i);
+            jobs.push_back(partition);
+        }
+        nPending[i] = scenarioJobs[i].size();
+    }
+
+    std::vector<ScenarioResult> jobResults(jobs.size());
+    std::vector<Worker> running;
+    std::size_t next = 0;
+
+    while (next < jobs.size() || !running.empty())
+    {
+        while (next < jobs.size() && running.size() < nWorkers)
+        {
+            int fds[2];
+            NS_ABORT_MSG_IF(pipe(fds) != 0, "pipe() failed: " << std::strerror(errno));
+            std::cout.flush();
+            pid_t pid = fork();
+            NS_ABORT_MSG_IF(pid < 0, "fork() failed: " << std::strerror(errno));
+            if (pid == 0)
+            {
+                close(fds[0]);
+                if (!WriteAll(fds[1], SerializeResult(RunScenario(jobs[next]))))
+                {
+                    _exit(1);
+                }
+                close(fds[1]);
+                std::cout.flush();
+                _exit(0);
+            }
+            close(fds[1]);
+            running.push_back({pid, fds[0], next, ""});
+            next++;
+        }
+
+        std::vector<pollfd> pollFds;
+        for (const auto& worker : running)
+        {
+            pollFds.push_back({worker.fd, POLLIN, 0});
+        }
+        if (poll(pollFds.data(), pollFds.size(), -1) < 0)
+        {
+            NS_ABORT_MSG_IF(errno != EINTR, "poll() failed: " << std::strerror(errno));
+            continue;
+        }
+
+        for (std::size_t i = pollFds.size(); i-- > 0;)
+        {
+            if (pollFds[i].revents == 0)
+            {
+                continue;
+            }
+            Worker& worker = running[i];
+            char buffer[4096];
+            ssize_t n = read(worker.fd, buffer, sizeof(buffer));
+            if (n > 0)
+            {
+                worker.data.append(buffer, n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            close(worker.fd);
+            int status;
+            waitpid(worker.pid, &status, 0);
+            std::size_t index = jobScenario[worker.index];
+            NS_ABORT_MSG_IF(!WIFEXITED(status) || WEXITSTATUS(status) != 0,
+                            "Worker process for sweep point " << index << " failed");
+            jobResults[worker.index] = DeserializeResult(worker.data);
+            running.erase(running.begin() + i);
+            if (--nPending[index] > 0)
+            {
+                continue;
+            }
+
+            std::vector<ScenarioConfig> partitions;
+            std::vector<ScenarioResult> partitionResults;
+            for (std::size_t job : scenarioJobs[index])
+            {
+                partitions.push_back(jobs[job]);
+                partitionResults.push_back(std::move(jobResults[job]));
+            }
+            results[index] = MergePartitions(partitions, partitionResults);
+            if (cache)
+            {
+                cache->Store(configs[index], results[index]);
+            }
+            if (onResult)
+            {
+                onResult(index, results[index]);
+            }
+        }
+    }
+    if (nCached > 0)
+    {
+        std::cout << nCached << " of " << configs.size() << " results taken from the cache"
+                  << std::endl;
+    }
+    return results;
+}
+
+/**
+ * Estimate the goodput of a scenario with Bianchi's model of the DCF.
+ *
+ * The senders (the AP in downlink, the stations in uplink) are saturated and contend with the EDCA
+ * parameters of AC_BE. Each transmission carries the largest A-MPDU allowed by the block ack
+ * buffer size, the maximum A-MPDU length and the maximum HE PPDU duration, followed by a block
+ * ack, and is preceded by RTS/CTS if enabled. The PPDU durations are computed by WifiPhy for the
+ * MCS, channel width and guard interval of the scenario. The model ignores the OFDMA, the losses
+ * due to the channel and the TCP acks, and caps the estimated capacity by the offered load. The
+ * BSSs are partitioned as in the simulation, and the estimates of the partitions are added.
+ *
+ * \param config the scenario
+ * \return the estimate
+ */
+AnalyticEstimate
+EstimateGoodput(const ScenarioConfig& config)
+{
+    WifiPhyBand band = (config.frequency == 6   ? WIFI_PHY_BAND_6GHZ
+                        : config.frequency == 5 ? WIFI_PHY_BAND_5GHZ
+                                                : WIFI_PHY_BAND_2_4GHZ);
+
+    WifiTxVector dataTxVector;
+    dataTxVector.SetMode(HePhy::GetHeMcs(config.mcs));
+    dataTxVector.SetPreambleType(WIFI_PREAMBLE_HE_SU);
+    dataTxVector.SetChannelWidth(config.channelWidth);
+    dataTxVector.SetGuardInterval(config.guardInterval);
+    dataTxVector.SetNss(1);
+    dataTxVector.SetNTx(1);
+
+    // same control rate as the ConstantRateWifiManager of the scenario
+    WifiTxVector ctrlTxVector = dataTxVector;
+    if (band != WIFI_PHY_BAND_6GHZ)
+    {
+        uint64_t nonHtRefRate = HePhy::GetNonHtReferenceRate(config.mcs);
+        ctrlTxVector.SetMode(band == WIFI_PHY_BAND_5GHZ ? OfdmPhy::GetOfdmRate(nonHtRefRate)
+                                                        : ErpOfdmPhy::GetErpOfdmRate(nonHtRefRate));
+        ctrlTxVector.SetPreambleType(WIFI_PREAMBLE_LONG);
+        ctrlTxVector.SetChannelWidth(20);
+        ctrlTxVector.SetGuardInterval(800);
+    }
+    auto ctrlDuration = [&](uint32_t size) {
+        return WifiPhy::CalculateTxDuration(size, ctrlTxVector, band).GetSeconds();
+    };
+
+    // UDP or TCP (with the timestamp option) and IPv4 headers, unless the MAC is fed directly
+    uint32_t msduSize =
+        config.payloadSize + (config.macSaturation ? 0 : (config.udp ? 8 : 32) + 20);
+    uint32_t mpduSize = msduSize + 8 + 30; // LLC/SNAP, QoS data header and FCS
+    uint32_t subframeSize = 4 + (mpduSize + 3) / 4 * 4; // delimiter and padding
+    uint32_t bufferSize = (config.useExtendedBlockAck ? 256 : 64);
+
+    AnalyticEstimate estimate;
+    estimate.mpdusPerAmpdu = std::min<uint32_t>(bufferSize, 6500631 / subframeSize);
+    while (estimate.mpdusPerAmpdu > 1 &&
+           WifiPhy::CalculateTxDuration(estimate.mpdusPerAmpdu * subframeSize, dataTxVector, band) >
+               MicroSeconds(MAX_PPDU_DURATION_US))
+    {
+        estimate.mpdusPerAmpdu--;
+    }
+    double data =
+        WifiPhy::CalculateTxDuration(estimate.mpdusPerAmpdu * subframeSize, dataTxVector, band)
+            .GetSeconds();
+
+    const double slot = 9e-6;
+    const double sifs = (band == WIFI_PHY_BAND_2_4GHZ ? 10e-6 : 16e-6);
+    const double aifs = sifs + 3 * slot; // AIFSN of AC_BE
+    double blockAck = ctrlDuration(bufferSize == 256 ? 56 : 32); // compressed block ack
+    double rtsCts = (config.useRts ? ctrlDuration(20) + sifs + ctrlDuration(14) + sifs : 0);
+    estimate.txDuration = rtsCts + data + sifs + blockAck;
+    double success = estimate.txDuration + aifs;
+    // the colliding senders wait for the CTS or block ack that does not come
+    double collision =
+        (config.useRts ? ctrlDuration(20) + sifs + ctrlDuration(14) : data + sifs + blockAck) +
+        aifs;
+
+    double stationLoad = (config.macSaturation ? std::numeric_limits<double>::infinity()
+                                               : config.load / config.nStations); // Mbit/s
+    estimate.offeredLoad = config.nBss * config.nStations * stationLoad;
+
+    // the BSSs of a partition are assumed to be in range of each other and share the medium, the
+    // partitions do not interfere; the collision probability is that of the busiest partition
+    for (const auto& partition : PartitionBss(config))
+    {
+        double nBss = (partition.bss.empty() ? config.nBss : partition.bss.size());
+
+        // probability tau that a sender transmits in a slot, given the probability p that its
+        // transmission collides; p = 1 - (1 - tau)^(n - 1) is solved by bisection
+        const double w = 16; // CWmin + 1 of AC_BE
+        const int m = 6;     // number of times the contention window doubles up to CWmax = 1023
+        double n = nBss * (config.downlink ? 1 : config.nStations);
+        auto getTau = [&](double p) {
+            double sum = 0;
+            for (int i = 0; i < m; i++)
+            {
+                sum += std::pow(2 * p, i);
+            }
+            return 2 / (1 + w + p * w * sum);
+        };
+        double low = 0;
+        double high = 1;
+        for (int i = 0; i < 64; i++)
+        {
+            double p = (low + high) / 2;
+            if (1 - std::pow(1 - getTau(p), n - 1) > p)
+            {
+                low = p;
+            }
+            else
+            {
+                high = p;
+            }
+        }
+        double collisionProbability = (low + high) / 2;
+        double tau = getTau(collisionProbability);
+
+        double pTransmission = 1 - std::pow(1 - tau, n);
+        double pSuccess = n * tau * std::pow(1 - tau, n - 1) / pTransmission;
+        double slotDuration = (1 - pTransmission) * slot + pTransmission * pSuccess * success +
+                              pTransmission * (1 - pSuccess) * collision;
+        double capacity = pTransmission * pSuccess * estimate.mpdusPerAmpdu * config.payloadSize *
+                          8 / slotDuration / 1e6;
+
+        estimate.capacity += capacity;
+        estimate.goodput += std::min(capacity, nBss * config.nStations * stationLoad);
+        estimate.collisionProbability =
+            std::max(estimate.collisionProbability, collisionProbability);
+    }
+    return estimate;
+}
+
+bool
+CapacitySearch::IsSustainable(const ScenarioResult& result) const
+{
+    double loss =
+        (result.txPackets > 0 ? 1 - static_cast<double>(result.rxPackets) / result.txPackets : 0);
+    return loss <= maxLoss && result.delays.GetCount() > 0 &&
+           result.delays.GetPercentile(99) <= maxDelay;
+}
+
+void
+CapacitySearch::Run(const std::vector<ScenarioConfig>& points,
+                    uint32_t nWorkers,
+                    const ResultsSink& sink,
+                    const ResultCache& cache) const
+{
+    struct Search
+    {
+        double low{0};           // highest sustainable load found, 0 if none
+        double high{0};          // lowest unsustainable load found, or the upper bound
+        bool highFailed{false};  // whether high was found unsustainable
+        double bound{0};         // highest value high may be raised to
+        ScenarioResult knee;     // result of the probe at low
+        uint32_t nProbes{0};
+    };
+
+    std::vector<Search> searches(points.size());
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        Search& search = searches[i];
+        if (maxLoad > 0)
+        {
+            search.high = maxLoad;
+            search.bound = maxLoad;
+            continue;
+        }
+        // the model does not cover OFDMA and may underestimate the capacity, or find none: a
+        // sustainable upper bound is doubled, up to the PHY rate of the channel, which no BSS
+        // can sustain
+        double phyRate = HePhy::GetHeMcs(points[i].mcs)
+                             .GetDataRate(points[i].channelWidth, points[i].guardInterval, 1) /
+                         1e6;
+        search.high = std::max(1.5 * EstimateGoodput(points[i]).capacity / points[i].nBss,
+                               0.1 * phyRate);
+        search.bound = std::max(search.high, phyRate);
+    }
+    auto isDone = [this](const Search& search) {
+        return search.high - search.low <= std::max(tolerance * search.high, 0.1);
+    };
+
+    for (uint32_t round = 1;; round++)
+    {
+        std::vector<std::size_t> active;
+        for (std::size_t i = 0; i < points.size(); i++)
+        {
+            if (!isDone(searches[i]))
+            {
+                active.push_back(i);
+            }
+        }
+        if (active.empty())
+        {
+            break;
+        }
+
+        // the workers are shared by the scenarios still searched, the loads of a scenario are
+        // probed in increasing order, and the upper bound only until it is found unsustainable
+        uint32_t nLoads = std::max<uint32_t>(1, nWorkers / active.size());
+        std::vector<ScenarioConfig> probes;
+        std::vector<std::size_t> probeSearch;
+        for (std::size_t i : active)
+        {
+            const Search& search = searches[i];
+            for (uint32_t j = 1; j <= nLoads; j++)
+            {
+                ScenarioConfig probe = points[i];
+                probe.load = search.low + (search.high - search.low) * j /
+                                              (search.highFailed ? nLoads + 1 : nLoads);
+                probes.push_back(probe);
+                probeSearch.push_back(i);
+            }
+        }
+        std::cout << "Round " << round << ": " << probes.size() << " probes of "
+                  << active.size() << " scenarios" << std::endl;
+
+        std::vector<ScenarioResult> results = RunScenarios(
+            probes,
+            nWorkers,
+            [&](std::size_t i, const ScenarioResult& result) { sink.Append(probes[i], result); },
+            &cache);
+
+        std::vector<bool> failed(points.size(), false);
+        for (std::size_t p = 0; p < probes.size(); p++)
+        {
+            Search& search = searches[probeSearch[p]];
+            search.nProbes++;
+            if (failed[probeSearch[p]])
+            {
+                continue;
+            }
+            if (IsSustainable(results[p]))
+            {
+                search.low = probes[p].load;
+                search.knee = results[p];
+            }
+            else
+            {
+                search.high = probes[p].load;
+                search.highFailed = true;
+                failed[probeSearch[p]] = true;
+            }
+        }
+        for (auto& search : searches)
+        {
+            if (!search.highFailed && search.low >= search.high && search.high < search.bound)
+            {
+                search.high = std::min(2 * search.high, search.bound);
+            }
+        }
+    }
+
+    std::cout << "mcs" << "\t" << "channelWidth [MHz]" << "\t" << "GI [ns]" << "\t" << "seed"
+              << "\t" << "knee [Mbit/s]" << "\t" << "goodput [Mbit/s]" << "\t" << "loss"
+              << "\t" << "p99 delay [ms]" << "\t" << "probes" << std::endl;
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        const Search& search = searches[i];
+        std::cout << points[i].mcs << "\t" << points[i].channelWidth << "\t\t\t"
+                  << points[i].guardInterval << "\t" << points[i].seed << "\t";
+        if (search.low == 0)
+        {
+            // no load was sustainable
+            std::cout << "<" << search.high << "\t-\t-\t-\t" << search.nProbes << std::endl;
+            continue;
+        }
+        const ScenarioResult& knee = search.knee;
+        std::cout << (search.highFailed ? "" : ">=") << search.low << "\t" << knee.throughput
+                  << "\t" << 1 - static_cast<double>(knee.rxPackets) / knee.txPackets << "\t"
+                  << knee.delays.GetPercentile(99).GetSeconds() * 1000 << "\t" << search.nProbes
+                  << std::endl;
+    }
+}
+
+/**
+ * Simulate every scenario with each MU scheduler, in parallel, and print their goodput and delay
+ * percentiles, the goodput being also given relative to the round robin scheduler.
+ *
+ * \param points the scenarios, whose muScheduler is ignored
+ * \param nWorkers the maximum number of concurrent worker processes
+ * \param sink the sink of the results of the runs
+ * \param cache the cache of the results of the runs
+ */
+void
+CompareMuSchedulers(const std::vector<ScenarioConfig>& points,
+                    uint32_t nWorkers,
+                    const ResultsSink& sink,
+                    const ResultCache& cache)
+{
+    const std::vector<std::string> schedulers{"rr", "pf", "maxweight"};
+    std::vector<ScenarioConfig> runs;
+    for (const auto& point : points)
+    {
+        for (const auto& scheduler : schedulers)
+        {
+            runs.push_back(point);
+            runs.back().muScheduler = scheduler;
+        }
+    }
+    std::vector<ScenarioResult> results = RunScenarios(
+        runs,
+        nWorkers,
+        [&](std::size_t i, const ScenarioResult& result) { sink.Append(runs[i], result); },
+        &cache);
+
+    std::cout << "mcs" << "\t" << "channelWidth [MHz]" << "\t" << "GI [ns]" << "\t" << "seed"
+              << "\t" << "scheduler" << "\t" << "goodput [Mbit/s]" << "\t" << "vs rr"
+              << "\t" << "p50/p95/p99/max delay [ms]" << std::endl;
+    for (std::size_t i = 0; i < runs.size(); i++)
+    {
+        const ScenarioResult& result = results[i];
+        const ScenarioResult& rr = results[i - i % schedulers.size()];
+        std::cout << runs[i].mcs << "\t" << runs[i].channelWidth << "\t\t\t"
+                  << runs[i].guardInterval << "\t" << runs[i].seed << "\t" << runs[i].muScheduler
+                  << "\t\t" << result.throughput << "\t\t\t";
+        if (rr.throughput > 0)
+        {
+            std::cout << std::showpos << 100 * (result.throughput / rr.throughput - 1)
+                      << std::noshowpos << "%";
+        }
+        else
+        {
+            std::cout << "-";
+        }
+        std::cout << "\t";
+        if (result.delays.GetCount() > 0)
+        {
+            std::cout << result.delays.GetPercentile(50).GetSeconds() * 1000 << " / "
+                      << result.delays.GetPercentile(95).GetSeconds() * 1000 << " / "
+                      << result.delays.GetPercentile(99).GetSeconds() * 1000 << " / "
+                      << result.delays.GetMax().GetSeconds() * 1000;
+        }
+        else
+        {
+            std::cout << "-";
+        }
+        std::cout << std::endl;
+    }
+}
+
+/**
+ * Check the measured goodput against the bounds given with minExpectedThroughput and
+ * maxExpectedThroughput, a bound equal to zero being ignored.
+ *
+ * \param lowest the lowest measured goodput in Mbit/s
+ * \param highest the highest measured goodput in Mbit/s
+ * \param minExpected the minimum expected goodput in Mbit/s
+ * \param maxExpected the maximum expected goodput in Mbit/s
+ * \return true if the goodput is within the bounds
+ */
+bool
+CheckExpectedThroughput(double lowest, double highest, double minExpected, double maxExpected)
+{
+    if (minExpected > 0 && lowest < minExpected)
+    {
+        std::cerr << "Obtained throughput " << lowest << " Mbit/s is below the minimum expected "
+                  << minExpected << " Mbit/s" << std::endl;
+        return false;
+    }
+    if (maxExpected > 0 && highest > maxExpected)
+    {
+        std::cerr << "Obtained throughput " << highest << " Mbit/s is above the maximum expected "
+                  << maxExpected << " Mbit/s" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/// Header of the golden goodput tables
+static const std::string GOLDEN_TABLE_HEADER = "mcs,channelWidth,guardInterval,udp,dlAckType,"
+                                               "phyModel,nStations,simulationTime,load,goodput,"
+                                               "tolerance";
+
+/**
+ * Simulate every point of a golden goodput table and compare the measured goodput with the
+ * expected one.
+ *
+ * The table is a CSV file with the columns of GOLDEN_TABLE_HEADER: the parameters of the point,
+ * its goodput (Mbit/s) and its tolerance (relative). Lines starting with '#' are comments. The
+ * other parameters of the points are taken from the command line, so the table must be checked
+ * with the options it was recorded with. Points with an empty goodput have not been recorded yet
+ * and fail the validation, unless allowUnrecorded is set.
+ *
+ * \param base the scenario providing every parameter that is not part of the table
+ * \param path the golden table
+ * \param nWorkers the number of worker processes
+ * \param update whether to store the measured goodputs in the table instead of checking them
+ * \param allowUnrecorded whether the points without a golden goodput are only reported
+ * \return the exit code of the program: 0 if every point is recorded (or allowUnrecorded is set)
+ *         and within its tolerance
+ */
+int
+ValidateGoldenTable(const ScenarioConfig& base,
+                    const std::string& path,
+                    uint32_t nWorkers,
+                    bool update,
+                    bool allowUnrecorded)
+{
+    struct GoldenEntry
+    {
+        std::string goodput; // empty if not recorded yet
+        double tolerance;
+    };
+
+    std::ifstream input(path);
+    NS_ABORT_MSG_IF(!input.is_open(), "Cannot open " << path);
+
+    std::vector<std::string> comments;
+    std::vector<ScenarioConfig> points;
+    std::vector<GoldenEntry> entries;
+    std::string line;
+    while (std::getline(input, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            comments.push_back(line);
+            continue;
+        }
+        if (line.rfind("mcs,", 0) == 0)
+        {
+            NS_ABORT_MSG_IF(line != GOLDEN_TABLE_HEADER,
+                            "The header of " << path << " must be " << GOLDEN_TABLE_HEADER);
+            continue;
+        }
+
+        std::vector<std::string> fields;
+        std::istringstream lineStream(line);
+        std::string field;
+        while (std::getline(lineStream, field, ','))
+        {
+            fields.push_back(field);
+        }
+        if (!line.empty() && line.back() == ',')
+        {
+            fields.emplace_back();
+        }
+        NS_ABORT_MSG_IF(fields.size() != 11, "Malformed golden table line \"" << line << "\"");
+
+        ScenarioConfig point = base;
+        point.mcs = std::stoi(fields[0]);
+        point.channelWidth = std::stoi(fields[1]);
+        point.guardInterval = std::stoi(fields[2]);
+        point.udp = (std::stoi(fields[3]) != 0);
+        point.dlAckSeqType = fields[4];
+        point.phyModel = fields[5];
+        point.nStations = std::stoul(fields[6]);
+        point.simulationTime = std::stod(fields[7]);
+        point.load = std::stod(fields[8]);
+        point.displayFlowStats = false;
+        point.showStats = false;
+        points.push_back(point);
+        entries.push_back({fields[9], fields[10].empty() ? 0.0 : std::stod(fields[10])});
+    }
+    input.close();
+
+    std::vector<ScenarioResult> results = RunScenarios(points, nWorkers);
+
+    if (update)
+    {
+        std::ofstream output(path, std::ios::out | std::ios::trunc);
+        NS_ABORT_MSG_IF(!output.is_open(), "Cannot open " << path);
+        for (const auto& comment : comments)
+        {
+            output << comment << "\n";
+        }
+        output << GOLDEN_TABLE_HEADER << "\n";
+        for (std::size_t i = 0; i < points.size(); i++)
+        {
+            output << points[i].mcs << "," << points[i].channelWidth << ","
+                   << points[i].guardInterval << "," << points[i].udp << ","
+                   << points[i].dlAckSeqType << "," << points[i].phyModel << ","
+                   << points[i].nStations << "," << points[i].simulationTime << ","
+                   << points[i].load << "," << std::setprecision(6)
+                   << results[i].throughput << "," << entries[i].tolerance << "\n";
+        }
+        std::cout << "Recorded " << points.size() << " points in " << path << std::endl;
+        return 0;
+    }
+
+    std::size_t nFailed = 0;
+    std::size_t nNotRecorded = 0;
+    std::cout << "mcs\twidth\tGI\tudp\tdlAckType\tphyModel\tnStations\tload"
+              << "\texpected\tmeasured\tdiff\tstatus" << std::endl;
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        std::cout << points[i].mcs << "\t" << points[i].channelWidth << "\t"
+                  << points[i].guardInterval << "\t" << points[i].udp << "\t"
+                  << points[i].dlAckSeqType << "\t" << points[i].phyModel << "\t"
+                  << points[i].nStations << "\t\t" << points[i].load << "\t";
+        if (entries[i].goodput.empty())
+        {
+            nNotRecorded++;
+            std::cout << "-\t" << results[i].throughput << "\t-\tNOT RECORDED" << std::endl;
+            continue;
+        }
+        double expected = std::stod(entries[i].goodput);
+        double diff = (expected > 0 ? (results[i].throughput - expected) / expected
+                                    : results[i].throughput);
+        bool ok = (std::abs(diff) <= entries[i].tolerance);
+        nFailed += (ok ? 0 : 1);
+        std::cout << expected << "\t" << results[i].throughput << "\t" << std::showpos
+                  << diff * 100 << "%" << std::noshowpos << "\t" << (ok ? "OK" : "FAIL")
+                  << std::endl;
+    }
+
+    if (nNotRecorded > 0)
+    {
+        std::cerr << nNotRecorded << " points have no golden goodput yet, record them with "
+                  << "--updateGolden=1" << std::endl;
+    }
+    if (nFailed > 0)
+    {
+        std::cerr << nFailed << " of " << points.size()
+                  << " points are outside their tolerance" << std::endl;
+    }
+    return (nFailed > 0 || (nNotRecorded > 0 && !allowUnrecorded) ? 1 : 0);
+}
+
+/**
+ * Simulate a fixed matrix of configurations (number of stations, PHY model, DL ack sequence type
+ * and UL OFDMA) and report, for each of them, the wall-clock setup and run times, the number and
+ * rate of events and the peak memory, as a JSON array. The configurations are simulated one at a
+ * time, each in its own process, so that the measurements do not interfere.
+ *
+ * \param base the scenario providing every parameter that is not part of the matrix
+ * \param path the output file, stdout if empty
+ */
+void
+RunBenchmark(const ScenarioConfig& base, const std::string& path)
+{
+    std::vector<ScenarioConfig> configs;
+    for (std::size_t nStations : {1, 4, 16, 64})
+    {
+        for (const std::string dlAckSeqType : {"NO-OFDMA", "ACK-SU-FORMAT", "MU-BAR", "AGGR-MU-BAR"})
+        {
+            for (const std::string phyModel : {"Yans", "Spectrum"})
+            {
+                for (bool enableUlOfdma : {false, true})
+                {
+                    // OFDMA requires Spectrum, and UL OFDMA requires DL OFDMA
+                    if ((dlAckSeqType != "NO-OFDMA" && phyModel == "Yans") ||
+                        (dlAckSeqType == "NO-OFDMA" && enableUlOfdma))
+                    {
+                        continue;
+                    }
+                    ScenarioConfig config = base;
+                    config.nStations = nStations;
+                    config.dlAckSeqType = dlAckSeqType;
+                    config.phyModel = phyModel;
+                    config.enableUlOfdma = enableUlOfdma;
+                    config.displayFlowStats = false;
+                    config.showStats = false;
+                    configs.push_back(config);
+                }
+            }
+        }
+    }
+
+    std::vector<ScenarioResult> results = RunScenarios(configs, 1);
+
+    std::ofstream file;
+    if (!path.empty())
+    {
+        file.open(path, std::ios::out | std::ios::trunc);
+        NS_ABORT_MSG_IF(!file.is_open(), "Cannot open " << path);
+    }
+    std::ostream& os = (path.empty() ? std::cout : file);
+
+    os << "[\n";
+    for (std::size_t i = 0; i < configs.size(); i++)
+    {
+        const ScenarioConfig& config = configs[i];
+        const ScenarioResult& result = results[i];
+        os << "  {\"nStations\": " << config.nStations << ", \"phyModel\": \"" << config.phyModel
+           << "\", \"dlAckType\": \"" << config.dlAckSeqType
+           << "\", \"enableUlOfdma\": " << (config.enableUlOfdma ? "true" : "false")
+           << ", \"scheduler\": \"" << config.scheduler
+           << "\", \"simulationTime\": " << config.simulationTime
+           << ", \"setupSeconds\": " << result.setupTime
+           << ", \"runSeconds\": " << result.runTime << ", \"events\": " << result.events
+           << ", \"eventsPerSecond\": " << (result.runTime > 0 ? result.events / result.runTime : 0)
+           << ", \"peakRssKiB\": " << result.peakRss
+           << ", \"throughputMbps\": " << result.throughput << "}"
+           << (i + 1 < configs.size() ? "," : "") << "\n";
+    }
+    os << "]" << std::endl;
+}
+
+/**
+ * Print the MAC and PHY counters of every station: the data MPDUs transmitted, retransmitted,
+ * acknowledged, not acknowledged and dropped (by reason), the mean number of MPDUs per PSDU, the
+ * PSDUs sent over each RU size and the PPDUs dropped by the PHY (by reason), in downlink and
+ * in uplink. Station 0 is the covert station.
+ *
+ * \param result the result of the scenario
+ */
+void
+ReportMacPhyCounters(const ScenarioResult& result)
+{
+    static const char* ruTones[MacPhyCounters::N_RU_TYPES] = {"26", "52", "106", "242",
+                                                              "484", "996", "2x996"};
+    static const char* dropReasons[MacPhyCounters::N_DROP_REASONS] = {"enqueue",
+                                                                      "lifetime",
+                                                                      "retryLimit",
+                                                                      "oldPacket"};
+    auto print = [](const std::string& name, const MacPhyCounters& counters) {
+        std::cout << name << "\t" << counters.txMpdus << "\t" << counters.retries << "\t"
+                  << counters.ackedMpdus << "\t" << counters.nackedMpdus << "\t"
+                  << (counters.dataPsdus > 0
+                          ? static_cast<double>(counters.txMpdus) / counters.dataPsdus
+                          : 0)
+                  << "\t";
+        std::string separator;
+        for (std::size_t i = 0; i < MacPhyCounters::N_DROP_REASONS; i++)
+        {
+            if (counters.droppedMpdus[i] > 0)
+            {
+                std::cout << separator << dropReasons[i] << ":" << counters.droppedMpdus[i];
+                separator = ",";
+            }
+        }
+        std::cout << (separator.empty() ? "-\t" : "\t");
+        separator.clear();
+        for (std::size_t i = 0; i < MacPhyCounters::N_RU_TYPES; i++)
+        {
+            if (counters.ruPsdus[i] > 0)
+            {
+                std::cout << separator << ruTones[i] << ":" << counters.ruPsdus[i];
+                separator = ",";
+            }
+        }
+        std::cout << (separator.empty() ? "-\t" : "\t");
+        separator.clear();
+        for (std::size_t i = 0; i < MacPhyCounters::N_RX_FAILURE_REASONS; i++)
+        {
+            if (counters.rxDrops[i] > 0)
+            {
+                std::cout << separator << static_cast<WifiPhyRxfailureReason>(i) << ":"
+                          << counters.rxDrops[i];
+                separator = ",";
+            }
+        }
+        std::cout << (separator.empty() ? "-" : "") << std::endl;
+    };
+
+    std::cout << "station\ttx MPDUs\tretries\tacked\tnot acked\tMPDUs/PSDU\tMAC drops"
+              << "\tRU PSDUs\tPHY drops" << std::endl;
+    for (std::size_t i = 0; i < result.stationDlMacPhy.size(); i++)
+    {
+        std::string name = std::to_string(i) + (i == 0 ? " (covert)" : "");
+        print(name + " DL", result.stationDlMacPhy[i]);
+        print(name + " UL", result.stationUlMacPhy[i]);
+    }
+    print("APs", result.apMacPhy);
+}
+
+/**
+ * Print the mean, the standard deviation and the half-width of the 95% confidence interval of the
+ * goodput, the mean delay and the loss ratio, in aggregate and for every station, over a set of
+ * independent replications.
+ *
+ * \param results the results of the replications
+ * \param nStations the number of stations
+ */
+void
+ReportReplications(const std::vector<ScenarioResult>& results, std::size_t nStations)
+{
+    struct Samples
+    {
+        std::vector<double> goodput; // Mbit/s
+        std::vector<double> delay;   // ms
+        std::vector<double> loss;    // ratio
+        DelayHistogram delays;       // delays of all the replications
+    };
+
+    // index 0 holds the aggregate, index i + 1 the station i
+    std::vector<Samples> samples(nStations + 1);
+    for (const auto& result : results)
+    {
+        samples[0].goodput.push_back(result.throughput);
+        samples[0].delay.push_back(result.delay * 1000);
+        samples[0].delays.Merge(result.delays);
+        samples[0].loss.push_back(
+            result.txPackets > 0 ? 1 - static_cast<double>(result.rxPackets) / result.txPackets
+                                 : 0);
+
+        for (std::size_t i = 0; i < nStations && i < result.stationRxBytes.size(); i++)
+        {
+            samples[i + 1].goodput.push_back(result.stationRxBytes[i] * 8 /
+                                             (result.duration * 1e6));
+        }
+        for (const auto& flow : result.flows)
+        {
+            if (flow.station < 0)
+            {
+                continue;
+            }
+            Samples& station = samples[flow.station + 1];
+            station.delay.push_back(flow.rxPackets > 0 ? flow.delaySum / flow.rxPackets * 1000
+                                                       : 0);
+            station.loss.push_back(
+                flow.txPackets > 0 ? 1 - static_cast<double>(flow.rxPackets) / flow.txPackets
+                                   : 0);
+            station.delays.Merge(flow.delays);
+        }
+    }
+
+    auto print = [](const std::vector<double>& values) {
+        std::size_t n = values.size();
+        double mean = 0;
+        for (double value : values)
+        {
+            mean += value;
+        }
+        mean = (n > 0 ? mean / n : 0);
+        double variance = 0;
+        for (double value : values)
+        {
+            variance += (value - mean) * (value - mean);
+        }
+        double stddev = (n > 1 ? std::sqrt(variance / (n - 1)) : 0);
+        double halfWidth = (n > 1 ? GetStudentT975(n - 1) * stddev / std::sqrt(n) : 0);
+        std::cout << "\t" << mean << "\t" << stddev << "\t" << halfWidth;
+    };
+
+    std::cout << results.size() << " replications, 95% confidence intervals" << std::endl;
+    std::cout << "station"
+              << "\tgoodput [Mbit/s] (mean, stddev, CI)"
+              << "\tdelay [ms] (mean, stddev, CI)"
+              << "\tloss ratio (mean, stddev, CI)" << std::endl;
+    for (std::size_t i = 0; i < samples.size(); i++)
+    {
+        std::cout << (i == 0 ? std::string("all") : std::to_string(i - 1));
+        print(samples[i].goodput);
+        print(samples[i].delay);
+        print(samples[i].loss);
+        std::cout << std::endl;
+    }
+
+    if (samples[0].delays.GetCount() == 0)
+    {
+        return;
+    }
+    std::cout << "delay percentiles of all the replications [ms]" << std::endl;
+    std::cout << "station\tp50\tp95\tp99\tmax" << std::endl;
+    for (std::size_t i = 0; i < samples.size(); i++)
+    {
+        const DelayHistogram& delays = samples[i].delays;
+        std::cout << (i == 0 ? std::string("all") : std::to_string(i - 1)) << "\t"
+                  << delays.GetPercentile(50).GetSeconds() * 1000 << "\t"
+                  << delays.GetPercentile(95).GetSeconds() * 1000 << "\t"
+                  << delays.GetPercentile(99).GetSeconds() * 1000 << "\t"
+                  << delays.GetMax().GetSeconds() * 1000 << std::endl;
+    }
+}
+
+/**
+ * Get the number of bytes received so far by a set of server applications.
+ *
+ * \param servers the server applications
+ * \param udp whether the servers are UdpServer (PacketSink otherwise) applications
+ * \param payloadSize the size of the UDP payloads
+ * \return the number of bytes received
+ */
+uint64_t
+GetRxBytes(const ApplicationContainer& servers, bool udp, uint32_t payloadSize)
+{
+    uint64_t rxBytes = 0;
+    for (uint32_t i = 0; i < servers.GetN(); i++)
+    {
+        if (udp)
+        {
+            rxBytes += payloadSize * DynamicCast<UdpServer>(servers.Get(i))->GetReceived();
+        }
+        else
+        {
+            rxBytes += DynamicCast<PacketSink>(servers.Get(i))->GetTotalRx();
+        }
+    }
+    return rxBytes;
+}
+
+/**
+ * Get the 97.5% quantile of the Student's t-distribution, used for two-sided 95% confidence
+ * intervals.
+ *
+ * \param degreesOfFreedom the number of degrees of freedom
+ * \return the quantile
+ */
+double
+GetStudentT975(uint32_t degreesOfFreedom)
+{
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                                   2.262,  2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                                   2.110,  2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                                   2.060,  2.056, 2.052, 2.048, 2.045, 2.042};
+    if (degreesOfFreedom == 0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    if (degreesOfFreedom <= 30)
+    {
+        return table[degreesOfFreedom - 1];
+    }
+    // first order Cornish-Fisher expansion around the normal quantile
+    return 1.96 + 2.373 / degreesOfFreedom;
+}
+
+/**
+ * \param path a file name
+ * \param suffix the suffix to insert
+ * \return the file name with the suffix inserted before its extension, if any
+ */
+std::string
+AddFileSuffix(const std::string& path, const std::string& suffix)
+{
+    auto dot = path.rfind('.');
+    return path.substr(0, dot) + suffix + (dot == std::string::npos ? "" : path.substr(dot));
+}
+
+/**
+ * Write the whole buffer to a file descriptor, retrying on partial writes.
+ *
+ * \param fd the file descriptor
+ * \param data the data to write
+ * \return true if everything was written
+ */
+bool
+WriteAll(int fd, const std::string& data)
+{
+    std::size_t written = 0;
+    while (written < data.size())
+    {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+/**
+ * Serialize a scenario result so that it can be sent from a worker process to its parent.
+ *
+ * \param result the result to serialize
+ * \return the serialized result
+ */
+std::string
+SerializeResult(const ScenarioResult& result)
+{
+    std::ostringstream oss;
+    oss << std::setprecision(std::numeric_limits<double>::max_digits10);
+    oss << "run"
+        << " rxBytes=" << result.rxBytes << " throughput=" << result.throughput
+        << " duration=" << result.duration << " txPackets=" << result.txPackets
+        << " rxPackets=" << result.rxPackets << " delay=" << result.delay
+        << " setupTime=" << result.setupTime << " runTime=" << result.runTime
+        << " events=" << result.events << " peakRss=" << result.peakRss << "\n";
+    for (const auto& flow : result.flows)
+    {
+        oss << "flow"
+            << " flowId=" << flow.flowId << " station=" << flow.station
+            << " source=" << flow.source
+            << " destination=" << flow.destination << " txPackets=" << flow.txPackets
+            << " rxPackets=" << flow.rxPackets << " txBytes=" << flow.txBytes
+            << " rxBytes=" << flow.rxBytes << " delaySum=" << flow.delaySum
+            << " firstRx=" << flow.firstRx << " lastRx=" << flow.lastRx
+            << " delays=" << flow.delays.Serialize() << "\n";
+    }
+    for (std::size_t i = 0; i < result.stationRxBytes.size(); i++)
+    {
+        oss << "station"
+            << " index=" << i << " rxBytes=" << result.stationRxBytes[i] << "\n";
+    }
+    for (std::size_t i = 0; i < result.stationDlMacPhy.size(); i++)
+    {
+        oss << "macphy"
+            << " index=" << i << " direction=dl counters=" << result.stationDlMacPhy[i].Serialize()
+            << "\n";
+        oss << "macphy"
+            << " index=" << i << " direction=ul counters=" << result.stationUlMacPhy[i].Serialize()
+            << "\n";
+    }
+    oss << "macphy"
+        << " index=-1 counters=" << result.apMacPhy.Serialize() << "\n";
+    return oss.str();
+}
+
+/**
+ * Rebuild a scenario result from the output of SerializeResult.
+ *
+ * \param data the serialized result
+ * \return the scenario result
+ */
+ScenarioResult
+DeserializeResult(const std::string& data)
+{
+    ScenarioResult result;
+    std::istringstream dataStream(data);
+    std::string line;
+    while (std::getline(dataStream, line))
+    {
+        std::istringstream lineStream(line);
+        std::string record;
+        lineStream >> record;
+        std::map<std::string, std::string> fields;
+        std::string token;
+        while (lineStream >> token)
+        {
+            auto pos = token.find('=');
+            NS_ABORT_MSG_IF(pos == std::string::npos, "Malformed result field \"" << token << "\"");
+            fields[token.substr(0, pos)] = token.substr(pos + 1);
+        }
+
+        if (record == "run")
+        {
+            result.rxBytes = std::stoull(fields.at("rxBytes"));
+            result.throughput = std::stod(fields.at("throughput"));
+            result.duration = std::stod(fields.at("duration"));
+            result.txPackets = std::stoull(fields.at("txPackets"));
+            result.rxPackets = std::stoull(fields.at("rxPackets"));
+            result.delay = std::stod(fields.at("delay"));
+            result.setupTime = std::stod(fields.at("setupTime"));
+            result.runTime = std::stod(fields.at("runTime"));
+            result.events = std::stoull(fields.at("events"));
+            result.peakRss = std::stol(fields.at("peakRss"));
+        }
+        else if (record == "flow")
+        {
+            FlowResult flow;
+            flow.flowId = std::stoul(fields.at("flowId"));
+            flow.station = std::stoi(fields.at("station"));
+            flow.source = fields.at("source");
+            flow.destination = fields.at("destination");
+            flow.txPackets = std::stoull(fields.at("txPackets"));
+            flow.rxPackets = std::stoull(fields.at("rxPackets"));
+            flow.txBytes = std::stoull(fields.at("txBytes"));
+            flow.rxBytes = std::stoull(fields.at("rxBytes"));
+            flow.delaySum = std::stod(fields.at("delaySum"));
+            flow.firstRx = std::stod(fields.at("firstRx"));
+            flow.lastRx = std::stod(fields.at("lastRx"));
+            flow.delays = DelayHistogram::Deserialize(fields.at("delays"));
+            if (flow.station >= 0)
+            {
+                result.delays.Merge(flow.delays);
+            }
+            result.flows.push_back(flow);
+        }
+        else if (record == "station")
+        {
+            std::size_t index = std::stoul(fields.at("index"));
+            result.stationRxBytes.resize(std::max(result.stationRxBytes.size(), index + 1));
+            result.stationRxBytes[index] = std::stoull(fields.at("rxBytes"));
+        }
+        else if (record == "macphy")
+        {
+            // index -1 holds the counters of the APs
+            int index = std::stoi(fields.at("index"));
+            MacPhyCounters counters = MacPhyCounters::Deserialize(fields.at("counters"));
+            if (index < 0)
+            {
+                result.apMacPhy = counters;
+                continue;
+            }
+            auto& stations = (fields.at("direction") == "dl" ? result.stationDlMacPhy
+                                                             : result.stationUlMacPhy);
+            stations.resize(std::max<std::size_t>(stations.size(), index + 1));
+            stations[index] = counters;
+        }
+        else
+        {
+            NS_ABORT_MSG("Unknown result record \"" << record << "\"");
+        }
+    }
+    return result;
+}
+
+void PopulateARPcache () 
+{
+	Ptr<ArpCache> arp = CreateObject<ArpCache> ();
+	arp->SetAliveTimeout (Seconds (3600 * 24 * 365) );
+
+	for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); ++i)
+	{
+		Ptr<Ipv4L3Protocol> ip = (*i)->GetObject<Ipv4L3Protocol> ();
+		NS_ASSERT (ip != nullptr);
+		ObjectVectorValue interfaces;
+		ip->GetAttribute ("InterfaceList", interfaces);
+
+		for (ObjectVectorValue::Iterator j = interfaces.Begin (); j != interfaces.End (); j++)
+		{
+			Ptr<Ipv4Interface> ipIface = (*j).second->GetObject<Ipv4Interface> ();
+			NS_ASSERT (ipIface != nullptr);
+			Ptr<NetDevice> device = ipIface->GetDevice ();
+			NS_ASSERT (device != nullptr);
+			Mac48Address addr = Mac48Address::ConvertFrom (device->GetAddress () );
+
+			for (uint32_t k = 0; k < ipIface->GetNAddresses (); k++)
+			{
+				Ipv4Address ipAddr = ipIface->GetAddress (k).GetLocal();
+				if (ipAddr == Ipv4Address::GetLoopback ())
+					continue;
+
+				ArpCache::Entry *entry = arp->Add (ipAddr);
+				Ipv4Header ipv4Hdr;
+				ipv4Hdr.SetDestination (ipAddr);
+				Ptr<Packet> p = Create<Packet> (100);
+				entry->MarkWaitReply (ArpCache::Ipv4PayloadHeaderPair (p, ipv4Hdr));
+				entry->MarkAlive (addr);
+			}
+		}
+	}
+
+	for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); ++i)
+	{
+		Ptr<Ipv4L3Protocol> ip = (*i)->GetObject<Ipv4L3Protocol> ();
+		NS_ASSERT (ip != nullptr);
+		ObjectVectorValue interfaces;
+		ip->GetAttribute ("InterfaceList", interfaces);
+
+		for (ObjectVectorValue::Iterator j = interfaces.Begin (); j != interfaces.End (); j ++)
+		{
+			Ptr<Ipv4Interface> ipIface = (*j).second->GetObject<Ipv4Interface> ();
+			ipIface->SetAttribute ("ArpCache", PointerValue (arp) );
+		}
+	}
+}
+
+/**
+ * Provision the ARP caches of a BSS whose nodes all share one IPv4 subnet, in a single pass over
+ * its devices. One permanent entry per address is added to an ARP cache shared by every
+ * interface of the BSS. No route needs to be installed, the on-link route added when the
+ * address was assigned covers the whole subnet.
+ *
+ * \param devices the devices of the AP and of the stations
+ */
+void
+ProvisionBss(const NetDeviceContainer& devices)
+{
+    Ptr<ArpCache> arp = CreateObject<ArpCache>();
+    arp->SetAliveTimeout(Seconds(3600 * 24 * 365));
+
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+        Ptr<NetDevice> device = devices.Get(i);
+        Ptr<Ipv4L3Protocol> ip = device->GetNode()->GetObject<Ipv4L3Protocol>();
+        NS_ASSERT(ip != nullptr);
+        int32_t ifIndex = ip->GetInterfaceForDevice(device);
+        NS_ASSERT(ifIndex >= 0);
+        Ptr<Ipv4Interface> ipIface = ip->GetInterface(ifIndex);
+
+        for (uint32_t k = 0; k < ipIface->GetNAddresses(); k++)
+        {
+            ArpCache::Entry* entry = arp->Add(ipIface->GetAddress(k).GetLocal());
+            entry->SetMacAddress(device->GetAddress());
+            entry->MarkPermanent();
+        }
+        ipIface->SetAttribute("ArpCache", PointerValue(arp));
+    }
+}
+
+/// EtherType of the frames used to prime the block ack agreements (local experimental)
+static const uint16_t PRIMER_PROTOCOL = 0x88B5;
+
+/**
+ * Send one frame on every flow, so that the block ack agreements are established before the
+ * traffic starts.
+ *
+ * \param state the warm-up state
+ */
+void
+SendPrimers(WarmupState* state)
+{
+    for (std::size_t i = 0; i < state->receivers.size(); i++)
+    {
+        state->senders.Get(i)->Send(Create<Packet>(100), state->receivers[i], PRIMER_PROTOCOL);
+    }
+}
+
+/**
+ * Trace sink for the association of a station; sends the priming frames once every station is
+ * associated.
+ *
+ * \param state the warm-up state
+ * \param staIndex the index of the station
+ * \param bssid the address of the AP the station associated with
+ */
+void
+NotifyAssociated(WarmupState* state, std::size_t staIndex, Mac48Address bssid)
+{
+    if (state->associated[staIndex])
+    {
+        return;
+    }
+    state->associated[staIndex] = true;
+    if (++state->nAssociated == state->associated.size())
+    {
+        Simulator::ScheduleNow(&SendPrimers, state);
+    }
+}
+
+/**
+ * Protocol handler for the priming frames; stops the warm-up phase once a priming frame was
+ * received on every flow. The block ack agreement of a flow is always established before its
+ * first data frame is delivered.
+ */
+void
+NotifyPrimerReceived(WarmupState* state,
+                     Ptr<NetDevice> device,
+                     Ptr<const Packet> packet,
+                     uint16_t protocol,
+                     const Address& from,
+                     const Address& to,
+                     NetDevice::PacketType packetType)
+{
+    if (++state->nPrimed == state->receivers.size())
+    {
+        Simulator::Stop();
+    }
+}
+
+/**
+ * Run the simulation until every station is associated with its AP and a block ack agreement
+ * is established on every flow. The stations probe actively, so this only takes a few
+ * milliseconds of simulated time, and the applications installed afterwards can start at once.
+ *
+ * \param staAps the device of the AP of every station, the stations of a BSS being contiguous
+ * \param staDevices the devices of the stations
+ * \param downlink whether the flows go from the AP to the stations
+ */
+void
+PreAssociate(NetDeviceContainer staAps, NetDeviceContainer staDevices, bool downlink)
+{
+    WarmupState state;
+    state.associated.resize(staDevices.GetN(), false);
+    Node::ProtocolHandler primerHandler = MakeBoundCallback(&NotifyPrimerReceived, &state);
+
+    for (uint32_t i = 0; i < staDevices.GetN(); i++)
+    {
+        Ptr<WifiNetDevice> staDevice = DynamicCast<WifiNetDevice>(staDevices.Get(i));
+        staDevice->GetMac()->TraceConnectWithoutContext(
+            "Assoc",
+            MakeBoundCallback(&NotifyAssociated, &state, static_cast<std::size_t>(i)));
+
+        Ptr<NetDevice> receiver = downlink ? staDevices.Get(i) : staAps.Get(i);
+        state.senders.Add(downlink ? staAps.Get(i) : staDevices.Get(i));
+        state.receivers.push_back(Mac48Address::ConvertFrom(receiver->GetAddress()));
+        if (downlink || i == 0 || staAps.Get(i) != staAps.Get(i - 1))
+        {
+            receiver->GetNode()->RegisterProtocolHandler(primerHandler, PRIMER_PROTOCOL, receiver);
+        }
+    }
+
+    EventId timeout = Simulator::Schedule(Seconds(10), static_cast<void (*)()>(&Simulator::Stop));
+    Simulator::Run();
+    NS_ABORT_MSG_IF(state.nPrimed < state.receivers.size(),
+                    "Only " << state.nAssociated << " of " << state.associated.size()
+                            << " stations associated and " << state.nPrimed << " of "
+                            << state.receivers.size() << " block ack agreements set up after 10 s");
+    timeout.Cancel();
+
+    // the state goes out of scope, detach everything that refers to it
+    for (uint32_t i = 0; i < staDevices.GetN(); i++)
+    {
+        DynamicCast<WifiNetDevice>(staDevices.Get(i))
+            ->GetMac()
+            ->TraceDisconnectWithoutContext(
+                "Assoc",
+                MakeBoundCallback(&NotifyAssociated, &state, static_cast<std::size_t>(i)));
+        if (downlink || i == 0 || staAps.Get(i) != staAps.Get(i - 1))
+        {
+            Ptr<NetDevice> receiver = downlink ? staDevices.Get(i) : staAps.Get(i);
+            receiver->GetNode()->UnregisterProtocolHandler(primerHandler);
+        }
+    }
+    NS_LOG_INFO("Warm-up completed at " << Simulator::Now().As(Time::MS));
+}
+
+Ptr<StaWifiMac> GetFirstStaWifiMac(NodeContainer& ap)
 {
   // We assume that covert sta is always the node 0.
   Ptr<NetDevice> netDevice = ap.Get(0)->GetDevice (0);
@@ -538,3 +5604,339 @@ Ptr<StaWifiMac> GetFirstStaWifiMac(NodeContainer& ap)
   Ptr<StaWifiMac> staMac = DynamicCast<StaWifiMac> (wifiMac);
   return staMac;
 }
+
+/**
+ * Describe a scenario with every field that may change its result, in a stable format.
+ *
+ * \param config the scenario
+ * \return the description
+ */
+std::string
+GetCanonicalConfig(const ScenarioConfig& config)
+{
+    std::ostringstream oss;
+    oss << std::setprecision(std::numeric_limits<double>::max_digits10);
+    oss << "udp=" << config.udp << " downlink=" << config.downlink << " useRts=" << config.useRts
+        << " useExtendedBlockAck=" << config.useExtendedBlockAck
+        << " simulationTime=" << config.simulationTime << " distance=" << config.distance
+        << " placement=" << config.placement << " cachePathLoss=" << config.cachePathLoss
+        << " frequency=" << config.frequency << " nStations=" << config.nStations
+        << " nBss=" << config.nBss << " bssSpacing=" << config.bssSpacing
+        << " channelPlan=" << config.channelPlan << " bss=";
+    for (uint32_t b : config.bss)
+    {
+        oss << b << ",";
+    }
+    oss << " dlAckType=" << config.dlAckSeqType << " enableUlOfdma=" << config.enableUlOfdma
+        << " enableBsrp=" << config.enableBsrp << " muScheduler=" << config.muScheduler
+        << " payloadSize=" << config.payloadSize
+        << " phyModel=" << config.phyModel
+        << " accessReqInterval=" << config.accessReqInterval.GetTimeStep()
+        << " channelWidth=" << config.channelWidth << " mcs=" << config.mcs
+        << " guardInterval=" << config.guardInterval << " load=" << config.load
+        << " burstSize=" << config.burstSize << " seed=" << config.seed
+        << " rngRun=" << config.rngRun << " scheduler=" << config.scheduler
+        << " preAssociate=" << config.preAssociate << " globalRouting=" << config.globalRouting
+        << " flowMonitor=" << config.flowMonitor << " macPhyStats=" << config.macPhyStats
+        << " macSaturation=" << config.macSaturation
+        << " macBacklog=" << config.macBacklog
+        << " sampleInterval=" << config.sampleInterval.GetTimeStep()
+        << " steadyStateTolerance=" << config.steadyStateTolerance
+        << " batchDuration=" << config.batchDuration.GetTimeStep()
+        << " minBatches=" << config.minBatches;
+    return oss.str();
+}
+
+/**
+ * Describe the environment of the scenarios: the default value of every attribute, the value of
+ * every global value, and the size and modification time of the program and of the ns-3
+ * libraries it loaded.
+ *
+ * The description is computed on the first call, which must precede the first scenario, since
+ * RunScenario() changes some attribute defaults.
+ *
+ * \return the description, computed once
+ */
+const std::string&
+GetCacheEnvironment()
+{
+    static const std::string environment = [] {
+        std::ostringstream oss;
+        for (uint16_t i = 0; i < TypeId::GetRegisteredN(); i++)
+        {
+            TypeId tid = TypeId::GetRegistered(i);
+            for (std::size_t j = 0; j < tid.GetAttributeN(); j++)
+            {
+                TypeId::AttributeInformation info = tid.GetAttribute(j);
+                std::string valueType = info.checker->GetValueTypeName();
+                if (valueType == "ns3::PointerValue" || valueType == "ns3::CallbackValue")
+                {
+                    continue; // serialized as addresses, which change from run to run
+                }
+                oss << tid.GetName() << "::" << info.name << "="
+                    << info.initialValue->SerializeToString(info.checker) << "\n";
+            }
+        }
+        for (auto it = GlobalValue::Begin(); it != GlobalValue::End(); ++it)
+        {
+            StringValue value;
+            (*it)->GetValue(value);
+            oss << (*it)->GetName() << "=" << value.Get() << "\n";
+        }
+
+        // the ns-3 libraries may be rebuilt without relinking the program
+        std::ifstream maps("/proc/self/maps");
+        std::set<std::string> files{"/proc/self/exe"};
+        std::string line;
+        while (std::getline(maps, line))
+        {
+            auto slash = line.find('/');
+            if (slash != std::string::npos && line.find("libns3", slash) != std::string::npos)
+            {
+                files.insert(line.substr(slash));
+            }
+        }
+        for (const auto& file : files)
+        {
+            struct stat fileStat;
+            if (stat(file.c_str(), &fileStat) == 0)
+            {
+                oss << file << "=" << fileStat.st_size << "@" << fileStat.st_mtime << "\n";
+            }
+        }
+        return oss.str();
+    }();
+    return environment;
+}
+
+/**
+ * \param data the data to hash
+ * \return the 64-bit FNV-1a hash of the data
+ */
+uint64_t
+GetFnv1aHash(const std::string& data)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data)
+    {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * \param config a scenario
+ * \param key the key of the scenario in the cache
+ * \return the name of the cache entry of the scenario, without directory
+ */
+std::string
+GetCacheEntryName(const ScenarioConfig& config, std::string& key)
+{
+    std::ostringstream environment;
+    environment << std::hex << std::setw(16) << std::setfill('0')
+                << GetFnv1aHash(GetCacheEnvironment());
+    key = GetCanonicalConfig(config) + " environment=" + environment.str();
+
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << GetFnv1aHash(key) << ".result";
+    return name.str();
+}
+
+bool
+ResultCache::Lookup(const ScenarioConfig& config, ScenarioResult& result) const
+{
+    if (dir.empty() || refresh || config.sampleInterval.IsStrictlyPositive() ||
+        !config.pcapPrefix.empty())
+    {
+        return false;
+    }
+
+    std::string key;
+    std::ifstream entry(dir + "/" + GetCacheEntryName(config, key));
+    std::string line;
+    if (!entry.is_open() || !std::getline(entry, line) || line != "key " + key)
+    {
+        return false;
+    }
+    std::ostringstream data;
+    data << entry.rdbuf();
+    result = DeserializeResult(data.str());
+    return true;
+}
+
+void
+ResultCache::Store(const ScenarioConfig& config, const ScenarioResult& result) const
+{
+    if (dir.empty() || config.sampleInterval.IsStrictlyPositive() || !config.pcapPrefix.empty())
+    {
+        return;
+    }
+    NS_ABORT_MSG_IF(mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST,
+                    "Cannot create " << dir << ": " << std::strerror(errno));
+
+    // write the entry under a temporary name, so that readers never see a partial entry
+    std::string key;
+    std::string name = GetCacheEntryName(config, key);
+    std::string path = dir + "/" + name;
+    std::string temporaryPath = path + "." + std::to_string(getpid());
+    {
+        std::ofstream entry(temporaryPath, std::ios::out | std::ios::trunc);
+        NS_ABORT_MSG_IF(!entry.is_open(), "Cannot open " << temporaryPath);
+        entry << "key " << key << "\n" << SerializeResult(result);
+    }
+
+    // the lock on the index serializes the workers, so that an entry is listed once, even when
+    // it is refreshed or stored by two workers at once
+    std::string indexPath = dir + "/index.tsv";
+    int fd = open(indexPath.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    NS_ABORT_MSG_IF(fd < 0, "Cannot open " << indexPath << ": " << std::strerror(errno));
+    NS_ABORT_MSG_IF(flock(fd, LOCK_EX) != 0,
+                    "Cannot lock " << indexPath << ": " << std::strerror(errno));
+    struct stat entryStat;
+    bool listed = (stat(path.c_str(), &entryStat) == 0);
+    NS_ABORT_MSG_IF(rename(temporaryPath.c_str(), path.c_str()) != 0,
+                    "Cannot rename " << temporaryPath << ": " << std::strerror(errno));
+    if (!listed)
+    {
+        NS_ABORT_MSG_IF(!WriteAll(fd, name + "\t" + GetCanonicalConfig(config) + "\n"),
+                        "Cannot write to " << indexPath << ": " << std::strerror(errno));
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+/// Header of the CSV results files
+static const std::string RESULTS_CSV_HEADER =
+    "record,mcs,channelWidth,guardInterval,nStations,nBss,channelPlan,loadMbps,udp,downlink,"
+    "dlAckType,muScheduler,seed,rngRun,flow,source,destination,txPackets,rxPackets,"
+    "throughputMbps,delayMs,delayP50Ms,delayP95Ms,delayP99Ms,delayMaxMs,lossRatio";
+
+/**
+ * Append the records of a scenario to the results file.
+ *
+ * \param config the scenario parameters
+ * \param result the scenario result
+ */
+void
+ResultsSink::Append(const ScenarioConfig& config, const ScenarioResult& result) const
+{
+    if (path.empty())
+    {
+        return;
+    }
+
+    struct Record
+    {
+        std::string type;
+        std::string flow;
+        std::string source;
+        std::string destination;
+        uint64_t txPackets;
+        uint64_t rxPackets;
+        double throughput; // Mbit/s
+        double delay;      // ms
+        const DelayHistogram* delays;
+    };
+
+    std::vector<Record> records;
+    records.push_back({"run",
+                       "",
+                       "",
+                       "",
+                       result.txPackets,
+                       result.rxPackets,
+                       result.throughput,
+                       result.delay * 1000,
+                       &result.delays});
+    for (const auto& flow : result.flows)
+    {
+        records.push_back(
+            {"flow",
+             std::to_string(flow.flowId),
+             flow.source,
+             flow.destination,
+             flow.txPackets,
+             flow.rxPackets,
+             (result.duration > 0 ? flow.rxBytes * 8 / (result.duration * 1e6) : 0),
+             (flow.rxPackets > 0 ? flow.delaySum / flow.rxPackets * 1000 : 0),
+             &flow.delays});
+    }
+
+    std::ostringstream oss;
+    oss << std::setprecision(10);
+    for (const auto& record : records)
+    {
+        double loss = (record.txPackets > record.rxPackets
+                           ? static_cast<double>(record.txPackets - record.rxPackets) /
+                                 record.txPackets
+                           : 0);
+        double p50 = record.delays->GetPercentile(50).GetSeconds() * 1000;
+        double p95 = record.delays->GetPercentile(95).GetSeconds() * 1000;
+        double p99 = record.delays->GetPercentile(99).GetSeconds() * 1000;
+        double max = record.delays->GetMax().GetSeconds() * 1000;
+        if (format == "csv")
+        {
+            // the channel plan is a ',' separated list, quoted
+            oss << record.type << "," << config.mcs << "," << config.channelWidth << ","
+                << config.guardInterval << "," << config.nStations << "," << config.nBss << ",\""
+                << config.channelPlan << "\"," << config.load << "," << config.udp << ","
+                << config.downlink << "," << config.dlAckSeqType << "," << config.muScheduler
+                << "," << config.seed << "," << config.rngRun << "," << record.flow << ","
+                << record.source << "," << record.destination << "," << record.txPackets << ","
+                << record.rxPackets << "," << record.throughput << "," << record.delay << ","
+                << p50 << "," << p95 << "," << p99 << "," << max << "," << loss << "\n";
+        }
+        else
+        {
+            oss << "{\"record\":\"" << record.type << "\",\"mcs\":" << config.mcs
+                << ",\"channelWidth\":" << config.channelWidth
+                << ",\"guardInterval\":" << config.guardInterval
+                << ",\"nStations\":" << config.nStations << ",\"nBss\":" << config.nBss
+                << ",\"channelPlan\":\"" << config.channelPlan << "\",\"loadMbps\":" << config.load
+                << ",\"udp\":" << (config.udp ? "true" : "false")
+                << ",\"downlink\":" << (config.downlink ? "true" : "false")
+                << ",\"dlAckType\":\"" << config.dlAckSeqType
+                << "\",\"muScheduler\":\"" << config.muScheduler << "\",\"seed\":" << config.seed
+                << ",\"rngRun\":" << config.rngRun;
+            if (record.type == "flow")
+            {
+                oss << ",\"flow\":" << record.flow << ",\"source\":\"" << record.source
+                    << "\",\"destination\":\"" << record.destination << "\"";
+            }
+            oss << ",\"txPackets\":" << record.txPackets << ",\"rxPackets\":" << record.rxPackets
+                << ",\"throughputMbps\":" << record.throughput << ",\"delayMs\":" << record.delay
+                << ",\"delayP50Ms\":" << p50 << ",\"delayP95Ms\":" << p95
+                << ",\"delayP99Ms\":" << p99 << ",\"delayMaxMs\":" << max
+                << ",\"lossRatio\":" << loss << "}\n";
+        }
+    }
+
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    NS_ABORT_MSG_IF(fd < 0, "Cannot open " << path << ": " << std::strerror(errno));
+    NS_ABORT_MSG_IF(flock(fd, LOCK_EX) != 0, "Cannot lock " << path << ": " << std::strerror(errno));
+
+    std::string data = oss.str();
+    struct stat fileStat;
+    if (format == "csv" && fstat(fd, &fileStat) == 0)
+    {
+        if (fileStat.st_size == 0)
+        {
+            data = RESULTS_CSV_HEADER + "\n" + data;
+        }
+        else
+        {
+            // the records must not be appended to a file written with other columns
+            std::string firstLine(RESULTS_CSV_HEADER.size() + 1, '\0');
+            ssize_t n = pread(fd, &firstLine[0], firstLine.size(), 0);
+            firstLine.resize(std::max<ssize_t>(n, 0));
+            NS_ABORT_MSG_IF(firstLine != RESULTS_CSV_HEADER + "\n",
+                            path << " was written with other columns than "
+                                 << RESULTS_CSV_HEADER << ", write the results to a new file");
+        }
+    }
+
+    NS_ABORT_MSG_IF(!WriteAll(fd, data), "Cannot write to " << path << ": " << std::strerror(errno));
+
+    flock(fd, LOCK_UN);
+    close(fd);
+}